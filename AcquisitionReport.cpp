@@ -0,0 +1,152 @@
+#include "AcquisitionReport.h"
+
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <sstream>
+
+void RunningStats::Reset() {
+    count_ = 0;
+    mean_ = 0.0;
+    m2_ = 0.0;
+    min_ = std::numeric_limits<double>::infinity();
+    max_ = -std::numeric_limits<double>::infinity();
+}
+
+void RunningStats::Add(double value) {
+    ++count_;
+    double delta = value - mean_;
+    mean_ += delta / count_;
+    m2_ += delta * (value - mean_);
+    if (value < min_)
+        min_ = value;
+    if (value > max_)
+        max_ = value;
+}
+
+double RunningStats::StdDev() const {
+    return count_ > 1 ? std::sqrt(m2_ / (count_ - 1)) : 0.0;
+}
+
+namespace {
+
+std::string JsonString(const std::string &s) {
+    std::string ret = "\"";
+    for (char c : s) {
+        switch (c) {
+        case '"':
+            ret += "\\\"";
+            break;
+        case '\\':
+            ret += "\\\\";
+            break;
+        case '\n':
+            ret += "\\n";
+            break;
+        case '\t':
+            ret += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                ret += buf;
+            } else {
+                ret += c;
+            }
+        }
+    }
+    return ret + "\"";
+}
+
+// JSON has no representation for infinity (empty series)
+double Finite(double v) { return std::isfinite(v) ? v : 0.0; }
+
+} // namespace
+
+std::string AcquisitionReport::ToJson() const {
+    std::ostringstream out;
+    out << "{\n";
+    out << "  \"startTime\": " << JsonString(startTime) << ",\n";
+
+    out << "  \"configuration\": {\n";
+    out << "    \"settings\": {";
+    for (std::size_t i = 0; i < settings.size(); ++i) {
+        out << (i ? ", " : "") << JsonString(settings[i].first) << ": "
+            << JsonString(settings[i].second);
+    }
+    out << "},\n";
+    out << "    \"roi\": {\"x\": " << roiX << ", \"y\": " << roiY
+        << ", \"width\": " << roiWidth << ", \"height\": " << roiHeight
+        << "},\n";
+    out << "    \"detectors\": [";
+    for (std::size_t i = 0; i < detectors.size(); ++i) {
+        out << (i ? ", " : "")
+            << "{\"name\": " << JsonString(detectors[i].first)
+            << ", \"enabled\": " << (detectors[i].second ? "true" : "false")
+            << "}";
+    }
+    out << "],\n";
+    out << "    \"channels\": " << numChannels << ",\n";
+    out << "    \"bytesPerPixel\": " << bytesPerPixel << ",\n";
+    out << "    \"stopOnOverflow\": " << (stopOnOverflow ? "true" : "false")
+        << "\n";
+    out << "  },\n";
+
+    out << "  \"requestedFrames\": ";
+    if (requestedFrames == LONG_MAX)
+        out << "null";
+    else
+        out << requestedFrames;
+    out << ",\n";
+    out << "  \"deliveredFrames\": " << framesDelivered << ",\n";
+    out << "  \"insertedImages\": " << imagesInserted << ",\n";
+    out << "  \"stoppedByUser\": " << (stoppedByUser ? "true" : "false")
+        << ",\n";
+    out << "  \"durationSeconds\": " << durationSeconds << ",\n";
+    out << "  \"drops\": {\"bufferOverflow\": " << imagesDroppedOnOverflow
+        << ", \"insertError\": " << imagesDroppedOther
+        << ", \"overflowEvents\": " << overflowEvents << "},\n";
+
+    out << "  \"frameIntervalMs\": {\"count\": " << frameIntervalMs.Count()
+        << ", \"mean\": " << frameIntervalMs.Mean()
+        << ", \"stdDev\": " << frameIntervalMs.StdDev()
+        << ", \"min\": " << Finite(frameIntervalMs.Min())
+        << ", \"max\": " << Finite(frameIntervalMs.Max()) << "},\n";
+
+    out << "  \"callbackLatencyUs\": [";
+    for (std::size_t i = 0; i < callbackLatency.size(); ++i) {
+        const ChannelLatency &l = callbackLatency[i];
+        out << (i ? "," : "") << "\n    {\"channel\": " << i
+            << ", \"count\": " << l.count << ", \"p50\": " << l.p50Us
+            << ", \"p90\": " << l.p90Us << ", \"p99\": " << l.p99Us
+            << ", \"p99.9\": " << l.p999Us << ", \"max\": " << l.maxUs << "}";
+    }
+    out << "\n  ]\n";
+    out << "}\n";
+    return out.str();
+}
+
+std::string AcquisitionReport::Summary() const {
+    uint64_t dropped = imagesDroppedOnOverflow + imagesDroppedOther;
+    double fps = durationSeconds > 0.0 ? framesDelivered / durationSeconds
+                                       : 0.0;
+    double worstP99 = 0.0;
+    for (const ChannelLatency &l : callbackLatency) {
+        if (l.p99Us > worstP99)
+            worstP99 = l.p99Us;
+    }
+
+    std::ostringstream out;
+    out << "Sequence acquisition " << (stoppedByUser ? "stopped" : "finished")
+        << ": " << framesDelivered;
+    if (requestedFrames != LONG_MAX)
+        out << '/' << requestedFrames;
+    out << " frames in " << durationSeconds << " s (" << fps
+        << " fps), " << dropped << " images dropped, " << overflowEvents
+        << " overflows, interval " << frameIntervalMs.Mean() << " +/- "
+        << frameIntervalMs.StdDev() << " ms, callback p99 " << worstP99
+        << " us";
+    return out.str();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+// Summary of one sequence acquisition, written as JSON when it ends.
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Mean, standard deviation and range of a series (Welford's algorithm)
+class RunningStats {
+    uint64_t count_;
+    double mean_;
+    double m2_;
+    double min_;
+    double max_;
+
+  public:
+    RunningStats() { Reset(); }
+    void Reset();
+    void Add(double value);
+    uint64_t Count() const { return count_; }
+    double Mean() const { return mean_; }
+    double StdDev() const;
+    double Min() const { return min_; }
+    double Max() const { return max_; }
+};
+
+struct AcquisitionReport {
+    // Configuration when the acquisition was started
+    std::string startTime; // Local time, ISO 8601
+    std::vector<std::pair<std::string, std::string>> settings;
+    uint32_t roiX = 0, roiY = 0, roiWidth = 0, roiHeight = 0;
+    std::vector<std::pair<std::string, bool>> detectors; // Name, enabled
+    unsigned numChannels = 0;
+    unsigned bytesPerPixel = 0;
+    long requestedFrames = 0; // LONG_MAX for continuous acquisition
+    bool stopOnOverflow = false;
+
+    // Outcome
+    bool stoppedByUser = false;
+    double durationSeconds = 0.0;
+    uint64_t framesDelivered = 0; // Channel 0
+    uint64_t imagesInserted = 0;  // All channels
+    uint64_t imagesDroppedOnOverflow = 0;
+    uint64_t imagesDroppedOther = 0;
+    uint64_t overflowEvents = 0;
+    RunningStats frameIntervalMs;
+
+    struct ChannelLatency {
+        uint64_t count;
+        double p50Us, p90Us, p99Us, p999Us, maxUs;
+    };
+    std::vector<ChannelLatency> callbackLatency;
+
+    std::string ToJson() const;
+    std::string Summary() const; // Single line, for the log
+};
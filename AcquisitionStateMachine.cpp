@@ -0,0 +1,71 @@
+#include "AcquisitionStateMachine.h"
+
+const char *AcquisitionStateName(AcquisitionState state) {
+    switch (state) {
+    case AcqState_Idle:
+        return "Idle";
+    case AcqState_Arming:
+        return "Arming";
+    case AcqState_Running:
+        return "Running";
+    case AcqState_Stopping:
+        return "Stopping";
+    case AcqState_Finished:
+        return "Finished";
+    case AcqState_Failed:
+        return "Failed";
+    default:
+        return "Unknown";
+    }
+}
+
+bool AcquisitionStateMachine::IsAllowed(AcquisitionState from,
+                                        AcquisitionState to) {
+    switch (from) {
+    case AcqState_Idle:
+    case AcqState_Finished:
+    case AcqState_Failed:
+        return to == AcqState_Arming;
+    case AcqState_Arming:
+        return to == AcqState_Running || to == AcqState_Stopping ||
+               to == AcqState_Failed;
+    case AcqState_Running:
+        return to == AcqState_Arming || to == AcqState_Stopping;
+    case AcqState_Stopping:
+        return to == AcqState_Finished || to == AcqState_Failed ||
+               to == AcqState_Arming;
+    default:
+        return false;
+    }
+}
+
+bool AcquisitionStateMachine::Transition(AcquisitionState from,
+                                         AcquisitionState to) {
+    if (!IsAllowed(from, to))
+        return false;
+    if (!state_.compare_exchange_strong(from, to, std::memory_order_acq_rel))
+        return false;
+    if (from == AcqState_Arming || from == AcqState_Stopping) {
+        // Lock so that a waiter cannot miss the notification
+        std::lock_guard<std::mutex> lock(mutex_);
+        cv_.notify_all();
+    }
+    return true;
+}
+
+bool AcquisitionStateMachine::BeginArming() {
+    AcquisitionState s = State();
+    while (s == AcqState_Idle || s == AcqState_Finished ||
+           s == AcqState_Failed) {
+        if (state_.compare_exchange_weak(s, AcqState_Arming,
+                                         std::memory_order_acq_rel))
+            return true;
+    }
+    return false;
+}
+
+AcquisitionState AcquisitionStateMachine::WaitWhile(AcquisitionState state) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this, state] { return State() != state; });
+    return State();
+}
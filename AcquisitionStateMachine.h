@@ -0,0 +1,85 @@
+#pragma once
+
+// State of the sequence acquisition, and ownership of its OSc_Acquisition.
+//
+// All transitions are compare-and-swap on a single atomic, so queries are a
+// memory load and concurrent requests (GUI stop, frame callback completion,
+// watchdog recovery) cannot both act on the same acquisition: only the
+// thread whose transition succeeded into Arming or Stopping may replace or
+// destroy the acquisition.
+//
+//   Idle/Finished/Failed -> Arming     Start (or re-arm from Running)
+//   Arming -> Running                  Acquisition armed and being started
+//   Arming -> Failed                   Could not arm or start
+//   Arming/Running -> Stopping         Stop requested or all frames received
+//   Stopping -> Finished/Failed        Teardown done, AcqFinished signaled
+//   Stopping -> Arming                 Teardown done, queued start begins
+//
+// Teardown runs in the background, so Stopping does not count as capturing:
+// from the caller's point of view the sequence has already ended (unless the
+// teardown still delivers buffered frames; see OpenScan::IsCapturing()).
+
+#include <OpenScanLib.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+enum AcquisitionState {
+    AcqState_Idle,
+    AcqState_Arming,
+    AcqState_Running,
+    AcqState_Stopping,
+    AcqState_Finished,
+    AcqState_Failed,
+    NUM_ACQ_STATES
+};
+
+const char *AcquisitionStateName(AcquisitionState state);
+
+class AcquisitionStateMachine {
+    std::atomic<AcquisitionState> state_;
+    OSc_Acquisition *acquisition_;
+
+    // Only for waiting on transitions out of Arming or Stopping
+    std::mutex mutex_;
+    std::condition_variable cv_;
+
+    static bool IsAllowed(AcquisitionState from, AcquisitionState to);
+
+  public:
+    AcquisitionStateMachine() : state_(AcqState_Idle), acquisition_(0) {}
+
+    AcquisitionStateMachine(const AcquisitionStateMachine &) = delete;
+    AcquisitionStateMachine &
+    operator=(const AcquisitionStateMachine &) = delete;
+
+    AcquisitionState State() const {
+        return state_.load(std::memory_order_acquire);
+    }
+
+    bool IsCapturing() const {
+        AcquisitionState s = State();
+        return s == AcqState_Arming || s == AcqState_Running;
+    }
+
+    // Returns false if the transition is not allowed or the state is not
+    // 'from' (another thread got there first)
+    bool Transition(AcquisitionState from, AcquisitionState to);
+
+    // Idle, Finished or Failed -> Arming; false if capturing or stopping
+    bool BeginArming();
+
+    // Waits until the state is other than 'state' (Arming or Stopping), and
+    // returns the new state
+    AcquisitionState WaitWhile(AcquisitionState state);
+
+    // Only by the thread that made the transition into Arming or Stopping
+    OSc_Acquisition *Acquisition() const { return acquisition_; }
+    void SetAcquisition(OSc_Acquisition *acq) { acquisition_ = acq; }
+    OSc_Acquisition *TakeAcquisition() {
+        OSc_Acquisition *acq = acquisition_;
+        acquisition_ = 0;
+        return acq;
+    }
+};
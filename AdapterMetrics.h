@@ -0,0 +1,58 @@
+#pragma once
+
+// Counters describing adapter activity, updated lock-free from the
+// acquisition path and read by diagnostics (metrics export, reports).
+
+#include <atomic>
+#include <cstdint>
+
+enum SnapPhase {
+    SnapPhase_Create, // Create and configure the acquisition
+    SnapPhase_Arm,
+    SnapPhase_Start,
+    SnapPhase_Wait, // Scanning and frame callbacks
+    SnapPhase_Total,
+    NUM_SNAP_PHASES
+};
+
+// Plain copy of the sequence counters, for per-acquisition differences
+struct SequenceCounts {
+    uint64_t framesDelivered;
+    uint64_t imagesInserted;
+    uint64_t imagesDropped;
+    uint64_t imagesDroppedOnOverflow;
+    uint64_t overflowEvents;
+};
+
+struct AdapterMetrics {
+    std::atomic<bool> sequenceRunning{false};
+
+    // Sequence acquisition, cumulative since initialization
+    std::atomic<uint64_t> sequencesStarted{0};
+    std::atomic<uint64_t> framesDelivered{0}; // Channel 0 only
+    std::atomic<uint64_t> imagesInserted{0};  // All channels
+    std::atomic<uint64_t> imagesDropped{0};
+    std::atomic<uint64_t> imagesDroppedOnOverflow{0}; // Subset of dropped
+    std::atomic<uint64_t> overflowEvents{0};
+    std::atomic<uint64_t> acquisitionStalls{0};
+    std::atomic<uint64_t> acquisitionRecoveries{0}; // Restarted after stall
+
+    std::atomic<uint64_t> snaps{0};
+    std::atomic<uint64_t> lastSnapPhaseNs[NUM_SNAP_PHASES] = {};
+    std::atomic<uint64_t> lastSnapStartToFrameNs{0}; // Start to channel 0
+
+    // Snaps and live starts that found (or did not find) a pre-armed
+    // acquisition, counted only while pre-arming is enabled
+    std::atomic<uint64_t> preArmHits{0};
+    std::atomic<uint64_t> preArmMisses{0};
+
+    std::atomic<uint64_t> errors{0};
+
+    // Adapter-owned image memory (snap buffers and the like)
+    std::atomic<int64_t> bufferBytesInUse{0};
+
+    SequenceCounts GetSequenceCounts() const {
+        return SequenceCounts{framesDelivered, imagesInserted, imagesDropped,
+                              imagesDroppedOnOverflow, overflowEvents};
+    }
+};
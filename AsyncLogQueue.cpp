@@ -0,0 +1,159 @@
+#include "AsyncLogQueue.h"
+
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+const std::chrono::milliseconds POLL_INTERVAL(10);
+const int64_t RATE_WINDOW_MS = 1000;
+
+int64_t NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+} // namespace
+
+AsyncLogQueue::AsyncLogQueue(Sink sink)
+    : sink_(std::move(sink)), slots_(new Slot[CAPACITY]), tail_(0), head_(0),
+      dropped_(0), minLevel_(OSc_LogLevel_Debug), rateLimit_(0),
+      stopRequested_(false) {
+    for (std::size_t i = 0; i < CAPACITY; ++i)
+        slots_[i].seq.store(i, std::memory_order_relaxed);
+}
+
+AsyncLogQueue::~AsyncLogQueue() { Stop(); }
+
+int AsyncLogQueue::AddSource(const std::string &name) {
+    sources_.emplace_back(new Source);
+    sources_.back()->name = name;
+    return static_cast<int>(sources_.size() - 1);
+}
+
+void AsyncLogQueue::Start() {
+    if (thread_.joinable())
+        return;
+    stopRequested_ = false;
+    thread_ = std::thread(&AsyncLogQueue::Run, this);
+}
+
+void AsyncLogQueue::Stop() {
+    if (!thread_.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopRequested_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+bool AsyncLogQueue::Admit(Source &source) {
+    uint32_t limit = rateLimit_.load(std::memory_order_relaxed);
+    if (limit == 0)
+        return true;
+    int64_t now = NowMs();
+    int64_t windowStart = source.windowStartMs.load(std::memory_order_relaxed);
+    if (now - windowStart >= RATE_WINDOW_MS &&
+        source.windowStartMs.compare_exchange_strong(windowStart, now)) {
+        source.countInWindow.store(0, std::memory_order_relaxed);
+    }
+    if (source.countInWindow.fetch_add(1, std::memory_order_relaxed) >=
+        limit) {
+        source.suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void AsyncLogQueue::Post(int source, const char *msg, OSc_LogLevel level) {
+    // Filter before doing any copying
+    if (level < minLevel_.load(std::memory_order_relaxed))
+        return;
+    if (source < 0 || source >= static_cast<int>(sources_.size()))
+        return;
+    // Warnings and errors are never rate limited
+    if (level <= OSc_LogLevel_Info && !Admit(*sources_[source]))
+        return;
+    if (!Enqueue(source, msg, level))
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Bounded MPMC queue algorithm (D. Vyukov), used with a single consumer
+bool AsyncLogQueue::Enqueue(int source, const char *msg, OSc_LogLevel level) {
+    std::size_t pos = tail_.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+        slot = &slots_[pos & (CAPACITY - 1)];
+        std::size_t seq = slot->seq.load(std::memory_order_acquire);
+        intptr_t diff =
+            static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (tail_.compare_exchange_weak(pos, pos + 1,
+                                            std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return false; // Full
+        } else {
+            pos = tail_.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->source = source;
+    slot->level = level;
+    std::strncpy(slot->text, msg, MAX_MESSAGE_LEN);
+    slot->text[MAX_MESSAGE_LEN] = '\0';
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+void AsyncLogQueue::Drain() {
+    for (;;) {
+        Slot &slot = slots_[head_ & (CAPACITY - 1)];
+        if (slot.seq.load(std::memory_order_acquire) != head_ + 1)
+            return;
+        std::string msg = "[" + sources_[slot.source]->name + "] ";
+        msg += slot.text;
+        bool debugOnly = slot.level <= OSc_LogLevel_Info;
+        slot.seq.store(head_ + CAPACITY, std::memory_order_release);
+        ++head_;
+        sink_(msg, debugOnly);
+    }
+}
+
+void AsyncLogQueue::ReportSuppressed() {
+    for (auto &source : sources_) {
+        uint64_t n = source->suppressed.exchange(0, std::memory_order_relaxed);
+        if (n > 0) {
+            sink_("[" + source->name + "] " + std::to_string(n) +
+                      " log messages suppressed by rate limit",
+                  false);
+        }
+    }
+    uint64_t n = dropped_.exchange(0, std::memory_order_relaxed);
+    if (n > 0) {
+        sink_(std::to_string(n) + " device log messages dropped (queue full)",
+              false);
+    }
+}
+
+void AsyncLogQueue::Run() {
+    int64_t lastReport = NowMs();
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopRequested_) {
+        lock.unlock();
+        Drain();
+        if (NowMs() - lastReport >= RATE_WINDOW_MS) {
+            ReportSuppressed();
+            lastReport = NowMs();
+        }
+        lock.lock();
+        cv_.wait_for(lock, POLL_INTERVAL, [this] { return stopRequested_; });
+    }
+    lock.unlock();
+    Drain();
+    ReportSuppressed();
+}
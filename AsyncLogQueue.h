@@ -0,0 +1,97 @@
+#pragma once
+
+// Asynchronous forwarding of OpenScanLib device log messages.
+//
+// Device modules may log from the acquisition thread; writing to the core
+// log there (which may involve file I/O) would stall frame delivery. Post()
+// filters by level and per-source rate, copies the message into a bounded
+// lock-free multi-producer queue and returns; a background thread forwards
+// queued messages to the sink. Posting never blocks: when the queue is full
+// the message is dropped and counted.
+//
+// Messages that exceed a source's rate limit (per second) are counted, and
+// the background thread logs a summary of suppressed and dropped counts.
+
+#include <OpenScanLib.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class AsyncLogQueue {
+  public:
+    // Receives the formatted message and whether it is debug-only
+    typedef std::function<void(const std::string &, bool)> Sink;
+
+    static const std::size_t CAPACITY = 1024; // Power of 2
+    static const std::size_t MAX_MESSAGE_LEN = 511;
+
+  private:
+    struct Slot {
+        std::atomic<std::size_t> seq;
+        int source;
+        OSc_LogLevel level;
+        char text[MAX_MESSAGE_LEN + 1];
+    };
+
+    struct Source {
+        std::string name;
+        std::atomic<int64_t> windowStartMs{0};
+        std::atomic<uint32_t> countInWindow{0};
+        std::atomic<uint64_t> suppressed{0};
+    };
+
+    Sink sink_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<std::size_t> tail_;
+    std::size_t head_; // Consumer thread only
+    std::atomic<uint64_t> dropped_;
+
+    std::vector<std::unique_ptr<Source>> sources_;
+    std::atomic<int> minLevel_;
+    std::atomic<uint32_t> rateLimit_; // Per source per second; 0 = no limit
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopRequested_;
+    std::thread thread_;
+
+    bool Admit(Source &source);
+    bool Enqueue(int source, const char *msg, OSc_LogLevel level);
+    void Drain();
+    void ReportSuppressed();
+    void Run();
+
+  public:
+    explicit AsyncLogQueue(Sink sink);
+    ~AsyncLogQueue();
+
+    AsyncLogQueue(const AsyncLogQueue &) = delete;
+    AsyncLogQueue &operator=(const AsyncLogQueue &) = delete;
+
+    // Sources must be added before Start(); returns the source index
+    int AddSource(const std::string &name);
+
+    void SetMinLevel(OSc_LogLevel level) { minLevel_ = level; }
+    OSc_LogLevel GetMinLevel() const {
+        return static_cast<OSc_LogLevel>(minLevel_.load());
+    }
+    void SetRateLimit(uint32_t messagesPerSecond) {
+        rateLimit_ = messagesPerSecond;
+    }
+    uint32_t GetRateLimit() const { return rateLimit_; }
+
+    void Start();
+    // Forwards any remaining messages before returning
+    void Stop();
+
+    // May be called from any thread
+    void Post(int source, const char *msg, OSc_LogLevel level);
+};
@@ -0,0 +1,43 @@
+#include "BackgroundWorker.h"
+
+#include <utility>
+
+BackgroundWorker::BackgroundWorker() : shutdownRequested_(false) {
+    thread_ = std::thread(&BackgroundWorker::Run, this);
+}
+
+BackgroundWorker::~BackgroundWorker() { Shutdown(); }
+
+void BackgroundWorker::Post(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+}
+
+void BackgroundWorker::Shutdown() {
+    if (!thread_.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shutdownRequested_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void BackgroundWorker::Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        cv_.wait(lock,
+                 [this] { return shutdownRequested_ || !tasks_.empty(); });
+        if (tasks_.empty())
+            return; // Shutdown requested and all tasks done
+        Task task = std::move(tasks_.front());
+        tasks_.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// Runs posted tasks, in order, on a single background thread.
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+class BackgroundWorker {
+  public:
+    typedef std::function<void()> Task;
+
+  private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Task> tasks_;
+    bool shutdownRequested_;
+    std::thread thread_;
+
+    void Run();
+
+  public:
+    BackgroundWorker();
+    ~BackgroundWorker();
+
+    BackgroundWorker(const BackgroundWorker &) = delete;
+    BackgroundWorker &operator=(const BackgroundWorker &) = delete;
+
+    // May be called from any thread, including from a task
+    void Post(Task task);
+
+    // Runs the remaining tasks, then stops the thread. Must not be called
+    // from a task.
+    void Shutdown();
+};
@@ -0,0 +1,60 @@
+#include "Debouncer.h"
+
+#include <utility>
+
+Debouncer::Debouncer(Function function, std::chrono::milliseconds delay)
+    : function_(std::move(function)), delay_(delay), pending_(false),
+      shutdownRequested_(false) {
+    thread_ = std::thread(&Debouncer::Run, this);
+}
+
+Debouncer::~Debouncer() { Shutdown(); }
+
+void Debouncer::SetDelay(std::chrono::milliseconds delay) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    delay_ = delay;
+}
+
+void Debouncer::Trigger() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_ = true;
+        deadline_ = std::chrono::steady_clock::now() + delay_;
+    }
+    cv_.notify_all();
+}
+
+void Debouncer::Cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_ = false;
+}
+
+void Debouncer::Shutdown() {
+    if (!thread_.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shutdownRequested_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+void Debouncer::Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!shutdownRequested_) {
+        if (!pending_) {
+            cv_.wait(lock, [this] { return pending_ || shutdownRequested_; });
+            continue;
+        }
+        // Trigger() may move the deadline while we wait
+        if (std::chrono::steady_clock::now() < deadline_) {
+            cv_.wait_until(lock, deadline_);
+            continue;
+        }
+        pending_ = false;
+        lock.unlock();
+        function_();
+        lock.lock();
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// Calls a function on a background thread once triggers have stopped
+// arriving for the delay (each Trigger() restarts the delay).
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+class Debouncer {
+  public:
+    typedef std::function<void()> Function;
+
+  private:
+    Function function_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::chrono::milliseconds delay_;
+    bool pending_;
+    std::chrono::steady_clock::time_point deadline_;
+    bool shutdownRequested_;
+    std::thread thread_;
+
+    void Run();
+
+  public:
+    Debouncer(Function function, std::chrono::milliseconds delay);
+    ~Debouncer();
+
+    Debouncer(const Debouncer &) = delete;
+    Debouncer &operator=(const Debouncer &) = delete;
+
+    void SetDelay(std::chrono::milliseconds delay);
+    void Trigger();
+    void Cancel();
+    // Waits for a call in progress; pending calls are dropped
+    void Shutdown();
+};
@@ -0,0 +1,171 @@
+#include "FlatField.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+namespace {
+
+// Gains are capped where the flat reference is (nearly) dark
+const double MAX_GAIN = double(UINT16_MAX) / FlatFieldCorrector::GAIN_ONE;
+
+// Subtraction, scaling and clamping in one pass over the frame. The product
+// of a 16-bit sample and a 16-bit gain fits in 32 bits.
+template <typename T>
+void Correct(const T *in, T *out, std::size_t n, const uint16_t *dark,
+             const uint16_t *gain) {
+    const uint32_t maxValue = std::numeric_limits<T>::max();
+    const uint32_t half = FlatFieldCorrector::GAIN_ONE / 2;
+    for (std::size_t i = 0; i < n; ++i) {
+        uint32_t d = dark[i];
+        uint32_t signal = std::max(uint32_t(in[i]), d) - d;
+        uint32_t v =
+            (signal * gain[i] + half) >> FlatFieldCorrector::GAIN_BITS;
+        out[i] = T(std::min(v, maxValue));
+    }
+}
+
+const char *KindName(CalibrationKind kind) {
+    return kind == Calibration_Dark ? "dark" : "flat";
+}
+
+// Keys hold setting values, which may contain any character
+std::string FileNamePart(const std::string &s) {
+    std::string ret = s;
+    for (char &c : ret) {
+        bool ok = (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') ||
+                  (c >= 'a' && c <= 'z') || c == '.' || c == '-';
+        if (!ok)
+            c = '_';
+    }
+    return ret;
+}
+
+} // namespace
+
+FlatFieldCorrector::FlatFieldCorrector(std::size_t pixels,
+                                       const std::vector<float> &dark,
+                                       const std::vector<float> &flat)
+    : dark_(pixels, 0), gain_(pixels, uint16_t(GAIN_ONE)) {
+    for (std::size_t i = 0; i < dark.size() && i < pixels; ++i) {
+        double d = std::min(std::max(double(dark[i]), 0.0), 65535.0);
+        dark_[i] = uint16_t(std::lround(d));
+    }
+    if (flat.size() < pixels)
+        return;
+
+    double mean = 0.0;
+    for (std::size_t i = 0; i < pixels; ++i)
+        mean += double(flat[i]) - dark_[i];
+    mean /= pixels;
+    if (mean <= 0.0)
+        return;
+    for (std::size_t i = 0; i < pixels; ++i) {
+        double signal = double(flat[i]) - dark_[i];
+        double gain = signal > mean / MAX_GAIN ? mean / signal : MAX_GAIN;
+        gain_[i] = uint16_t(std::lround(std::min(gain, MAX_GAIN) * GAIN_ONE));
+    }
+}
+
+bool FlatFieldCorrector::Apply(const void *in, void *out,
+                               std::size_t bytesPerPixel) const {
+    switch (bytesPerPixel) {
+    case 1:
+        Correct(static_cast<const uint8_t *>(in), static_cast<uint8_t *>(out),
+                Pixels(), dark_.data(), gain_.data());
+        return true;
+    case 2:
+        Correct(static_cast<const uint16_t *>(in),
+                static_cast<uint16_t *>(out), Pixels(), dark_.data(),
+                gain_.data());
+        return true;
+    default:
+        return false;
+    }
+}
+
+void CalibrationStore::SetDirectory(const std::string &directory) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    directory_ = directory;
+    correctors_.clear();
+}
+
+std::string CalibrationStore::GetDirectory() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return directory_;
+}
+
+// Caller holds the mutex
+std::string CalibrationStore::ReferencePath(CalibrationKind kind,
+                                            const std::string &key,
+                                            std::size_t chan) const {
+    return directory_ + "/" + KindName(kind) + "-" + FileNamePart(key) +
+           "-ch" + std::to_string(chan) + ".f32";
+}
+
+// Caller holds the mutex. Files of the wrong size are ignored.
+bool CalibrationStore::LoadReference(CalibrationKind kind,
+                                     const std::string &key, std::size_t chan,
+                                     std::size_t pixels,
+                                     std::vector<float> &image) const {
+    image.clear();
+    FILE *fp = fopen(ReferencePath(kind, key, chan).c_str(), "rb");
+    if (!fp)
+        return false;
+    image.resize(pixels + 1);
+    bool ok = fread(image.data(), sizeof(float), pixels + 1, fp) == pixels;
+    fclose(fp);
+    image.resize(ok ? pixels : 0);
+    return ok;
+}
+
+std::string CalibrationStore::Save(CalibrationKind kind,
+                                   const std::string &key, std::size_t chan,
+                                   const std::vector<float> &image) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (directory_.empty())
+        return std::string();
+    std::string path = ReferencePath(kind, key, chan);
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (!fp)
+        return std::string();
+    bool ok = fwrite(image.data(), sizeof(float), image.size(), fp) ==
+              image.size();
+    if (fclose(fp) != 0)
+        ok = false;
+    correctors_.erase(key);
+    return ok ? path : std::string();
+}
+
+CalibrationStore::Correctors CalibrationStore::Get(const std::string &key,
+                                                   std::size_t channels,
+                                                   std::size_t pixels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = correctors_.find(key);
+    if (found != correctors_.end() && found->second.size() >= channels)
+        return Correctors(found->second.begin(),
+                          found->second.begin() + channels);
+
+    Correctors correctors(channels);
+    bool any = false;
+    if (!directory_.empty()) {
+        for (std::size_t chan = 0; chan < channels; ++chan) {
+            std::vector<float> dark, flat;
+            bool hasDark =
+                LoadReference(Calibration_Dark, key, chan, pixels, dark);
+            bool hasFlat =
+                LoadReference(Calibration_Flat, key, chan, pixels, flat);
+            if (hasDark || hasFlat) {
+                correctors[chan] =
+                    std::make_shared<const FlatFieldCorrector>(pixels, dark,
+                                                               flat);
+                any = true;
+            }
+        }
+    }
+    if (!any)
+        correctors.clear();
+    correctors_[key] = correctors;
+    return correctors;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+// Dark-frame and flat-field correction of raw detector samples.
+//
+// For each channel and configuration, a dark reference (detector offset,
+// acquired with no light) and a flat reference (uniform sample) are stored
+// as the mean of several frames. Frames are corrected as
+// (raw - dark) * gain, where the gain normalizes the dark-subtracted flat to
+// its mean, so that illumination falloff is removed without changing the
+// overall brightness.
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum CalibrationKind {
+    Calibration_Dark,
+    Calibration_Flat,
+};
+
+// Correction for one channel in one configuration; immutable
+class FlatFieldCorrector {
+  public:
+    static const int GAIN_BITS = 12;
+    static const uint32_t GAIN_ONE = 1u << GAIN_BITS;
+
+    // Either reference may be empty: no offset, or unit gain
+    FlatFieldCorrector(std::size_t pixels, const std::vector<float> &dark,
+                       const std::vector<float> &flat);
+
+    std::size_t Pixels() const { return dark_.size(); }
+
+    // False (nothing written) unless bytesPerPixel is 1 or 2. May be done
+    // in place.
+    bool Apply(const void *in, void *out, std::size_t bytesPerPixel) const;
+
+  private:
+    std::vector<uint16_t> dark_;
+    std::vector<uint16_t> gain_; // Fixed point, GAIN_BITS fractional bits
+};
+
+// Per-channel references, keyed by configuration, kept as raw float files
+// in a directory and loaded on first use. Thread-safe.
+class CalibrationStore {
+  public:
+    // Per channel; null where a channel has no references
+    typedef std::vector<std::shared_ptr<const FlatFieldCorrector>> Correctors;
+
+  private:
+    std::mutex mutex_;
+    std::string directory_;
+    std::map<std::string, Correctors> correctors_; // Loaded so far, by key
+
+    std::string ReferencePath(CalibrationKind kind, const std::string &key,
+                              std::size_t chan) const;
+    bool LoadReference(CalibrationKind kind, const std::string &key,
+                       std::size_t chan, std::size_t pixels,
+                       std::vector<float> &image) const;
+
+  public:
+    void SetDirectory(const std::string &directory);
+    std::string GetDirectory();
+
+    // Writes the reference and drops the correctors for the configuration,
+    // so that the next Get() reloads them. Returns the file path, or empty
+    // if the file cannot be written.
+    std::string Save(CalibrationKind kind, const std::string &key,
+                     std::size_t chan, const std::vector<float> &image);
+
+    // Correctors for the first channels of the configuration; empty if no
+    // channel has references
+    Correctors Get(const std::string &key, std::size_t channels,
+                   std::size_t pixels);
+};
@@ -0,0 +1,524 @@
+#include "FramePipeline.h"
+
+#include "PixelKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+// Pixels per block of the median kernels. Each compare-exchange step of the
+// sorting network runs over a whole block (with SSE2, 16 or 8 pixels per
+// instruction), with the working set in L1.
+const std::size_t MEDIAN_BLOCK_PIXELS = 256;
+
+// Element-wise median of K arrays, using an odd-even transposition sorting
+// network
+template <typename T, int K>
+void Median(const T *const *inputs, T *out, std::size_t n) {
+    T v[K][MEDIAN_BLOCK_PIXELS];
+    for (std::size_t base = 0; base < n; base += MEDIAN_BLOCK_PIXELS) {
+        std::size_t m = std::min(MEDIAN_BLOCK_PIXELS, n - base);
+        for (int j = 0; j < K; ++j)
+            std::memcpy(v[j], inputs[j] + base, m * sizeof(T));
+        for (int pass = 0; pass < K; ++pass) {
+            for (int j = pass % 2; j + 1 < K; j += 2)
+                CompareExchange(v[j], v[j + 1], m);
+        }
+        std::memcpy(out + base, v[K / 2], m * sizeof(T));
+    }
+}
+
+template <typename T>
+void TemporalMedian(const T *const *frames, int k, T *out, std::size_t n) {
+    switch (k) {
+    case 3:
+        return Median<T, 3>(frames, out, n);
+    case 5:
+        return Median<T, 5>(frames, out, n);
+    case 7:
+        return Median<T, 7>(frames, out, n);
+    case 9:
+        return Median<T, 9>(frames, out, n);
+    }
+}
+
+// Spatial filters work row by row from three source rows with their edge
+// pixels replicated, so the working set is a few rows regardless of frame
+// size. Frames of at least this many pixels are split across threads.
+const std::size_t PARALLEL_MIN_PIXELS = 1 << 20;
+
+template <typename T> void PadRow(const T *row, std::size_t width, T *padded) {
+    padded[0] = row[0];
+    std::memcpy(padded + 1, row, width * sizeof(T));
+    padded[width + 1] = row[width - 1];
+}
+
+// Binomial [1 2 1] x [1 2 1] / 16
+template <typename T>
+void Gaussian3x3Row(const T *const *rows, T *out, std::size_t width) {
+    const T *a = rows[0];
+    const T *b = rows[1];
+    const T *c = rows[2];
+    for (std::size_t x = 0; x < width; ++x) {
+        uint32_t sum = uint32_t(a[x]) + 2u * a[x + 1] + a[x + 2] +
+                       2u * (uint32_t(b[x]) + 2u * b[x + 1] + b[x + 2]) +
+                       c[x] + 2u * c[x + 1] + c[x + 2];
+        out[x] = T((sum + 8) >> 4);
+    }
+}
+
+template <typename T>
+void SpatialFilterRows(int filter, const T *in, T *out, std::size_t width,
+                       std::size_t height, std::size_t rowBegin,
+                       std::size_t rowEnd, T *scratch) {
+    T *rows[3] = {scratch, scratch + width + 2, scratch + 2 * (width + 2)};
+    for (std::size_t y = rowBegin; y < rowEnd; ++y) {
+        PadRow(in + (y > 0 ? y - 1 : 0) * width, width, rows[0]);
+        PadRow(in + y * width, width, rows[1]);
+        PadRow(in + std::min(y + 1, height - 1) * width, width, rows[2]);
+        if (filter == FramePipeline::SpatialFilter_Median3x3) {
+            const T *taps[9];
+            for (int r = 0; r < 3; ++r) {
+                for (int dx = 0; dx < 3; ++dx)
+                    taps[3 * r + dx] = rows[r] + dx;
+            }
+            Median<T, 9>(taps, out + y * width, width);
+        } else {
+            Gaussian3x3Row(rows, out + y * width, width);
+        }
+    }
+}
+
+// Line phase shifts are applied with linear interpolation in fixed point
+const int PHASE_FRACTION_BITS = 8;
+const int32_t PHASE_ONE = 1 << PHASE_FRACTION_BITS;
+// Line pairs used per phase estimate, spread over the frame
+const std::size_t PHASE_ESTIMATE_ROWS = 64;
+
+template <typename T>
+inline T Interpolate(T a, T b, uint32_t frac, uint32_t inv) {
+    return T((uint32_t(a) * inv + uint32_t(b) * frac + PHASE_ONE / 2) >>
+             PHASE_FRACTION_BITS);
+}
+
+// out[x] = in[x + shift], shift in units of 1 / PHASE_ONE pixel; samples
+// beyond the row are clamped to the edge pixels
+template <typename T>
+void ShiftRow(const T *in, T *out, std::size_t width, int32_t shift) {
+    long w = long(width);
+    long whole = shift >> PHASE_FRACTION_BITS; // Floor
+    uint32_t frac = uint32_t(shift) & (PHASE_ONE - 1);
+    uint32_t inv = PHASE_ONE - frac;
+    // Both samples lie in the row for x in [begin, end)
+    long begin = std::min(std::max(-whole, 0L), w);
+    long end = std::max(std::min(w - 1 - whole, w), begin);
+    auto at = [&](long i) { return in[std::min(std::max(i, 0L), w - 1)]; };
+    for (long x = 0; x < begin; ++x)
+        out[x] = Interpolate(at(x + whole), at(x + whole + 1), frac, inv);
+    for (long x = begin; x < end; ++x)
+        out[x] = Interpolate(in[x + whole], in[x + whole + 1], frac, inv);
+    for (long x = end; x < w; ++x)
+        out[x] = Interpolate(at(x + whole), at(x + whole + 1), frac, inv);
+}
+
+// Estimates how far odd rows are displaced (in units of 1 / PHASE_ONE
+// pixel) relative to the mean of the even rows around them, from the peak
+// of their zero-mean cross-correlation. Returns false if the frame has too
+// little structure. Scratch holds two rows of doubles.
+template <typename T>
+bool EstimateLinePhase(const T *in, std::size_t width, std::size_t height,
+                       double *scratch, int32_t &phase) {
+    const int maxShift = FramePipeline::MAX_PHASE_SHIFT;
+    if (height < 3 || width <= std::size_t(4 * maxShift))
+        return false;
+
+    double corr[2 * FramePipeline::MAX_PHASE_SHIFT + 1] = {};
+    double *ref = scratch;
+    double *odd = scratch + width;
+    std::size_t pairs = (height - 1) / 2;
+    std::size_t step = std::max<std::size_t>(1, pairs / PHASE_ESTIMATE_ROWS);
+    for (std::size_t p = 0; p < pairs; p += step) {
+        std::size_t y = 2 * p + 1;
+        const T *above = in + (y - 1) * width;
+        const T *row = in + y * width;
+        const T *below = in + (y + 1) * width;
+        double refMean = 0.0, oddMean = 0.0;
+        for (std::size_t x = 0; x < width; ++x) {
+            ref[x] = 0.5 * (double(above[x]) + below[x]);
+            odd[x] = row[x];
+            refMean += ref[x];
+            oddMean += odd[x];
+        }
+        refMean /= width;
+        oddMean /= width;
+        for (std::size_t x = 0; x < width; ++x) {
+            ref[x] -= refMean;
+            odd[x] -= oddMean;
+        }
+        // The same reference pixels for every shift, so that the sums are
+        // comparable
+        for (int s = -maxShift; s <= maxShift; ++s) {
+            double sum = 0.0;
+            for (std::size_t x = maxShift; x < width - maxShift; ++x)
+                sum += ref[x] * odd[x + s];
+            corr[s + maxShift] += sum;
+        }
+    }
+
+    int best = 0;
+    for (int i = 1; i <= 2 * maxShift; ++i) {
+        if (corr[i] > corr[best])
+            best = i;
+    }
+    // A peak at the edge of the search range is not a real peak
+    if (best == 0 || best == 2 * maxShift || corr[best] <= 0.0)
+        return false;
+
+    // Sub-pixel position from a parabola through the peak
+    double left = corr[best - 1], mid = corr[best], right = corr[best + 1];
+    double curvature = left - 2.0 * mid + right;
+    double delta = curvature < 0.0 ? 0.5 * (left - right) / curvature : 0.0;
+    phase = int32_t(std::lround((best - maxShift + delta) * PHASE_ONE));
+    return true;
+}
+
+} // namespace
+
+FramePipeline::FramePipeline()
+    : scanWidth_(0), scanHeight_(0), binning_(1), width_(0), height_(0),
+      bytesPerPixel_(0), outputBytesPerPixel_(0), sampleBits_(0),
+      output_(OutputFormat_Native), accumulateFrames_(1), spatialThreads_(1),
+      phaseFramesSeen_(0), linePhaseEnabled_(true), linePhase_(0),
+      phaseEstimateInterval_(0),
+      binningMode_(BinningMode_Average), conversion_(Conversion_Shift),
+      windowMin_(0), windowMax_(UINT16_MAX), medianFrames_(1),
+      recursiveGain_(GAIN_ONE), spatialFilter_(SpatialFilter_None) {}
+
+// Buffers are resized rather than cleared: every stage writes its output in
+// full before it is read, and repeated configuration with the same geometry
+// (as for each snap) then costs no allocation or memory traffic.
+void FramePipeline::Configure(const Config &config) {
+    std::size_t bytesPerPixel = config.bytesPerPixel;
+    scanWidth_ = config.scanWidth;
+    scanHeight_ = config.scanHeight;
+    // Other sample sizes pass through unbinned and unconverted
+    bool processed = bytesPerPixel == 1 || bytesPerPixel == 2;
+    binning_ = config.binning > 1 && processed ? config.binning : 1;
+    width_ = scanWidth_ / binning_;
+    height_ = scanHeight_ / binning_;
+    bytesPerPixel_ = bytesPerPixel;
+    output_ = processed ? config.output : OutputFormat_Native;
+    if (output_ == OutputFormat_8Bit && bytesPerPixel != 2)
+        output_ = OutputFormat_Native;
+    bool convert = output_ == OutputFormat_8Bit;
+    bool wide = output_ == OutputFormat_32BitMean;
+    outputBytesPerPixel_ = convert ? 1 : wide ? 4 : bytesPerPixel;
+    accumulateFrames_ =
+        wide ? std::min(std::max(config.accumulate, std::size_t(1)),
+                        std::size_t(MAX_ACCUMULATE_FRAMES))
+             : 1;
+    sampleBits_ = std::min(std::max(config.sampleBits, 8u),
+                           unsigned(8 * bytesPerPixel));
+    linePhaseEnabled_ = config.linePhase;
+    linearization_ = config.linearization;
+    std::size_t scanBytes = scanWidth_ * scanHeight_ * bytesPerPixel;
+    std::size_t n = width_ * height_;
+    channels_.resize(config.channels);
+    bool median = medianFrames_ > 1;
+    for (std::size_t chan = 0; chan < config.channels; ++chan) {
+        Channel &c = channels_[chan];
+        c.flatField = chan < config.flatField.size() ? config.flatField[chan]
+                                                     : nullptr;
+        c.flatCorrected.resize(c.flatField ? scanBytes : 0);
+        c.corrected.resize(scanBytes);
+        c.linearized.resize(linearization_ ? scanBytes : 0);
+        c.binned.resize(binning_ > 1 ? n * bytesPerPixel : 0);
+        c.history.resize(median ? MAX_MEDIAN_FRAMES * n * bytesPerPixel : 0);
+        c.historyFrames = 0;
+        c.historyCount = 0;
+        c.historyNext = 0;
+        c.average.resize(n);
+        c.averagePrimed = false;
+        c.output.resize(n * bytesPerPixel);
+        c.filtered.resize(n * bytesPerPixel);
+        c.converted.resize(convert || wide ? n * outputBytesPerPixel_ : 0);
+        c.accumulated.resize(
+            accumulateFrames_ > 1 ? accumulateFrames_ * n * bytesPerPixel : 0);
+        c.accumulatedCount = 0;
+        c.accumulatedNext = 0;
+        c.sum.resize(wide ? n : 0);
+    }
+
+    // Kept while the thread count stays the same, so that configuring
+    // repeatedly (as for each snap) starts no threads
+    std::size_t threads =
+        n >= PARALLEL_MIN_PIXELS
+            ? std::max(1u, std::min(std::thread::hardware_concurrency(),
+                                    unsigned(MAX_SPATIAL_THREADS)))
+            : 1;
+    if (threads == 1)
+        spatialWorkers_.reset();
+    else if (!spatialWorkers_ || threads != spatialThreads_)
+        spatialWorkers_.reset(new WorkerPool(threads));
+    spatialThreads_ = threads;
+    rowScratch_.resize(spatialThreads_ * 3 * (width_ + 2) * bytesPerPixel);
+    phaseScratch_.resize(2 * scanWidth_);
+    binColumnSums_.resize(binning_ > 1 ? width_ * binning_ : 0);
+    phaseFramesSeen_ = 0;
+}
+
+void FramePipeline::SetLinePhase(double pixels) {
+    double limit = MAX_PHASE_SHIFT;
+    pixels = std::min(std::max(pixels, -limit), limit);
+    linePhase_ = int32_t(std::lround(pixels * PHASE_ONE));
+}
+
+double FramePipeline::GetLinePhase() const {
+    return double(linePhase_) / PHASE_ONE;
+}
+
+void FramePipeline::SetLinePhaseEstimateInterval(int frames) {
+    phaseEstimateInterval_ = std::max(frames, 0);
+}
+
+void FramePipeline::SetMedianFrames(int frames) {
+    frames = std::min(std::max(frames, 1), int(MAX_MEDIAN_FRAMES));
+    medianFrames_ = frames % 2 ? frames : frames - 1;
+}
+
+void FramePipeline::SetSpatialFilter(SpatialFilter filter) {
+    spatialFilter_ = filter;
+}
+
+void FramePipeline::SetRecursiveGain(double gain) {
+    long g = std::lround(gain * GAIN_ONE);
+    recursiveGain_ = g < 1 ? 1 : g > GAIN_ONE ? GAIN_ONE : int32_t(g);
+}
+
+double FramePipeline::GetRecursiveGain() const {
+    return double(recursiveGain_) / GAIN_ONE;
+}
+
+template <typename T> T *FramePipeline::FlatFieldStage(Channel &c, T *in) {
+    if (!c.flatField)
+        return in;
+    T *out = reinterpret_cast<T *>(c.flatCorrected.data());
+    c.flatField->Apply(in, out, sizeof(T));
+    return out;
+}
+
+template <typename T>
+T *FramePipeline::LinePhaseStage(Channel &c, std::size_t chan, T *in) {
+    if (!linePhaseEnabled_)
+        return in;
+    // All channels share the scanner, so channel 0 is enough to estimate
+    int interval = phaseEstimateInterval_;
+    if (chan == 0 && interval > 0 && phaseFramesSeen_++ % interval == 0) {
+        int32_t phase;
+        if (EstimateLinePhase(in, scanWidth_, scanHeight_,
+                              phaseScratch_.data(), phase))
+            linePhase_ = phase;
+    }
+
+    int32_t shift = linePhase_;
+    if (shift == 0)
+        return in;
+    T *out = reinterpret_cast<T *>(c.corrected.data());
+    for (std::size_t y = 0; y < scanHeight_; ++y) {
+        const T *src = in + y * scanWidth_;
+        T *dst = out + y * scanWidth_;
+        if (y % 2)
+            ShiftRow(src, dst, scanWidth_, shift);
+        else
+            std::memcpy(dst, src, scanWidth_ * sizeof(T));
+    }
+    return out;
+}
+
+template <typename T>
+T *FramePipeline::LinearizationStage(Channel &c, T *in) {
+    if (!linearization_)
+        return in;
+    T *out = reinterpret_cast<T *>(c.linearized.data());
+    linearization_->Apply(in, out, scanHeight_, sizeof(T));
+    return out;
+}
+
+template <typename T> T *FramePipeline::BinningStage(Channel &c, T *in) {
+    if (binning_ == 1)
+        return in;
+    T *out = reinterpret_cast<T *>(c.binned.data());
+    bool sum = binningMode_ == BinningMode_Sum;
+    BinBlocks(in, scanWidth_, out, width_, height_, unsigned(binning_), sum,
+              binColumnSums_.data());
+    return out;
+}
+
+// Passes frames through until the history is full
+template <typename T>
+T *FramePipeline::TemporalMedianStage(Channel &c, T *in) {
+    int k = medianFrames_;
+    if (k < 2 || c.history.empty()) {
+        c.historyFrames = 0;
+        return in;
+    }
+    if (k != c.historyFrames) {
+        c.historyFrames = k;
+        c.historyCount = 0;
+        c.historyNext = 0;
+    }
+
+    std::size_t n = width_ * height_;
+    T *history = reinterpret_cast<T *>(c.history.data());
+    std::memcpy(history + c.historyNext * n, in, n * sizeof(T));
+    c.historyNext = (c.historyNext + 1) % k;
+    if (c.historyCount < k)
+        ++c.historyCount;
+    if (c.historyCount < k)
+        return in;
+
+    // The median does not depend on frame order
+    const T *frames[MAX_MEDIAN_FRAMES];
+    for (int j = 0; j < k; ++j)
+        frames[j] = history + j * n;
+    T *out = reinterpret_cast<T *>(c.output.data());
+    TemporalMedian(frames, k, out, n);
+    return out;
+}
+
+// May process in place
+template <typename T>
+T *FramePipeline::RecursiveFilterStage(Channel &c, T *in) {
+    int32_t gain = recursiveGain_;
+    std::size_t n = width_ * height_;
+    if (gain >= GAIN_ONE) {
+        // Restart from the next frame when re-enabled
+        c.averagePrimed = false;
+        return in;
+    }
+    if (!c.averagePrimed) {
+        PrimeAverage(in, c.average.data(), n);
+        c.averagePrimed = true;
+        return in;
+    }
+    T *out = reinterpret_cast<T *>(c.output.data());
+    RecursiveFilter(in, c.average.data(), out, n, gain);
+    return out;
+}
+
+template <typename T>
+T *FramePipeline::SpatialFilterStage(Channel &c, T *in) {
+    int filter = spatialFilter_;
+    if (filter == SpatialFilter_None || width_ == 0 || height_ == 0)
+        return in;
+
+    T *out = reinterpret_cast<T *>(c.filtered.data());
+    T *scratch = reinterpret_cast<T *>(rowScratch_.data());
+    std::size_t scratchPerThread = 3 * (width_ + 2);
+    // The pool may have fewer threads than requested
+    std::size_t threads =
+        spatialWorkers_ ? std::min(spatialWorkers_->Threads(), height_) : 1;
+    auto rows = [&](std::size_t t) {
+        if (t < threads) {
+            SpatialFilterRows(filter, in, out, width_, height_,
+                              height_ * t / threads,
+                              height_ * (t + 1) / threads,
+                              scratch + t * scratchPerThread);
+        }
+    };
+    if (threads > 1)
+        spatialWorkers_->RunOnAll(rows);
+    else
+        rows(0);
+    return out;
+}
+
+void *FramePipeline::ConvertTo8Bit(Channel &c, uint16_t *in) {
+    uint8_t *out = c.converted.data();
+    if (conversion_ == Conversion_Window) {
+        // An empty window becomes a threshold
+        int32_t min = std::min(std::max(windowMin_.load(), 0), UINT16_MAX - 1);
+        int32_t max = std::min(std::max(windowMax_.load(), min + 1),
+                               int32_t(UINT16_MAX));
+        WindowTo8Bit(in, out, width_ * height_, uint32_t(min), uint32_t(max));
+    } else {
+        ShiftTo8Bit(in, out, width_ * height_, sampleBits_ - 8);
+    }
+    return out;
+}
+
+// Sum of the frame and up to accumulateFrames_ - 1 before it
+template <typename T>
+uint32_t *FramePipeline::AccumulateStage(Channel &c, T *in) {
+    std::size_t n = width_ * height_;
+    uint32_t *sum = c.sum.data();
+    if (accumulateFrames_ == 1) {
+        WidenFrame(in, sum, n);
+        c.accumulatedCount = 1;
+        return sum;
+    }
+
+    T *slot = reinterpret_cast<T *>(c.accumulated.data()) +
+              c.accumulatedNext * n;
+    if (c.accumulatedCount == accumulateFrames_) {
+        ReplaceFrame(in, slot, sum, n);
+    } else {
+        if (c.accumulatedCount == 0)
+            WidenFrame(in, sum, n);
+        else
+            AddFrame(in, sum, n);
+        std::memcpy(slot, in, n * sizeof(T));
+        ++c.accumulatedCount;
+    }
+    c.accumulatedNext = (c.accumulatedNext + 1) % accumulateFrames_;
+    return sum;
+}
+
+template <typename T> void *FramePipeline::OutputStage(Channel &c, T *in) {
+    switch (output_) {
+    case OutputFormat_8Bit:
+        return ConvertTo8Bit(c, in);
+    case OutputFormat_32BitMean: {
+        uint32_t *sum = AccumulateStage(c, in);
+        float *out = reinterpret_cast<float *>(c.converted.data());
+        MeanToFloat(sum, out, width_ * height_, c.accumulatedCount);
+        return out;
+    }
+    default:
+        return in;
+    }
+}
+
+template <typename T>
+void *FramePipeline::ProcessChannel(Channel &c, std::size_t chan, T *in) {
+    // Calibration references are of raw samples
+    T *frame = FlatFieldStage(c, in);
+    // The phase offset is uniform in acquired samples, so it is corrected
+    // before resampling
+    frame = LinePhaseStage(c, chan, frame);
+    frame = LinearizationStage(c, frame);
+    // Later stages run on the smaller frame
+    frame = BinningStage(c, frame);
+    // Spikes are removed before they can enter the average
+    frame = TemporalMedianStage(c, frame);
+    frame = RecursiveFilterStage(c, frame);
+    frame = SpatialFilterStage(c, frame);
+    return OutputStage(c, frame);
+}
+
+void *FramePipeline::Process(std::size_t chan, void *pixels) {
+    if (chan >= channels_.size())
+        return pixels;
+    Channel &c = channels_[chan];
+    switch (bytesPerPixel_) {
+    case 1:
+        return ProcessChannel(c, chan, static_cast<uint8_t *>(pixels));
+    case 2:
+        return ProcessChannel(c, chan, static_cast<uint16_t *>(pixels));
+    default:
+        return pixels;
+    }
+}
@@ -0,0 +1,220 @@
+#pragma once
+
+// Per-channel processing of sequence frames, run on the frame callback
+// before frames are inserted into the core or kept in memory.
+//
+// Stages, in order: dark/flat correction, line phase correction, scan
+// linearization, binning, temporal median, recursive average, spatial
+// filter, output conversion (or accumulation into 32-bit float means).
+// Stages before binning see frames at the scan size, and only the output
+// stage changes the sample size.
+//
+// Configure() (called while arming, with no frames arriving) sizes all
+// buffers and resets filter state; Process() does not allocate. Filter
+// parameters may be changed from any thread at any time. Only 8- and 16-bit
+// samples are processed; other frames pass through unchanged.
+//
+// Kernels use fixed-point integer arithmetic. Those of binning, the median
+// filters, the recursive filter and the output stage (8-bit conversion and
+// 32-bit accumulation) are in PixelKernels.h, with SSE2 implementations;
+// dark/flat correction, line phase correction, scan linearization and the
+// Gaussian filter are plain loops, left to the compiler to optimize.
+// Spatial filtering of large frames is split by rows across a pool of
+// threads started by Configure().
+
+#include "FlatField.h"
+#include "ScanLinearization.h"
+#include "WorkerPool.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class FramePipeline {
+  public:
+    // Fixed-point scale of the recursive filter gain
+    static const int GAIN_BITS = 10;
+    static const int32_t GAIN_ONE = 1 << GAIN_BITS;
+    static const int MAX_MEDIAN_FRAMES = 9;
+    static const unsigned MAX_SPATIAL_THREADS = 8;
+    static const int MAX_PHASE_SHIFT = 16; // Pixels
+    static const unsigned MAX_BINNING = 8;
+    // Keeps sums of 16-bit samples below 2^31
+    static const unsigned MAX_ACCUMULATE_FRAMES = 64;
+
+    enum BinningMode {
+        BinningMode_Average,
+        BinningMode_Sum, // Saturating
+    };
+
+    // Sample size of processed frames
+    enum OutputFormat {
+        OutputFormat_Native,
+        OutputFormat_8Bit,      // From 16-bit samples
+        OutputFormat_32BitMean, // float mean of accumulated frames
+    };
+
+    // Mapping of 16-bit samples to 8 bits
+    enum Conversion {
+        Conversion_Shift,  // Top 8 of the sample bits
+        Conversion_Window, // Window min to max mapped to 0 to 255
+    };
+
+    // Fixed while frames are processed
+    struct Config {
+        std::size_t channels;
+        std::size_t scanWidth; // Input frame size
+        std::size_t scanHeight;
+        std::size_t bytesPerPixel; // Input sample size
+        unsigned sampleBits;       // Significant bits of input samples
+        std::size_t binning;       // 1, 2, 4 or MAX_BINNING
+        OutputFormat output;
+        bool linePhase; // False to skip line phase correction
+        // Frames averaged for 32-bit output: each output frame covers the
+        // last this many (fewer at the start)
+        std::size_t accumulate;
+        // Must match the scan width; may be null
+        std::shared_ptr<const LinearizationTable> linearization;
+        // Per channel, possibly fewer or null; must match the scan size
+        CalibrationStore::Correctors flatField;
+    };
+
+    enum SpatialFilter {
+        SpatialFilter_None,
+        SpatialFilter_Median3x3,
+        SpatialFilter_Gaussian3x3,
+    };
+
+  private:
+    struct Channel {
+        std::shared_ptr<const FlatFieldCorrector> flatField; // May be null
+        std::vector<unsigned char> flatCorrected;
+        std::vector<unsigned char> corrected; // Line phase corrected
+        std::vector<unsigned char> linearized;
+        std::vector<unsigned char> binned;
+        // Last frames for the temporal median, one allocation for up to
+        // MAX_MEDIAN_FRAMES frames, used as a circular buffer
+        std::vector<unsigned char> history;
+        int historyFrames; // Median length the history was collected for
+        int historyCount;
+        int historyNext;
+        std::vector<int32_t> average; // Fixed point; see PixelKernels.cpp
+        bool averagePrimed;
+        std::vector<unsigned char> output;
+        std::vector<unsigned char> filtered; // Spatial filter output
+        std::vector<unsigned char> converted;
+        // Last frames for 32-bit output, used as a circular buffer, and
+        // their sum
+        std::vector<unsigned char> accumulated;
+        std::size_t accumulatedCount;
+        std::size_t accumulatedNext;
+        std::vector<uint32_t> sum;
+    };
+    std::vector<Channel> channels_;
+    std::size_t scanWidth_; // Input frame size
+    std::size_t scanHeight_;
+    std::size_t binning_;
+    std::size_t width_; // Output frame size
+    std::size_t height_;
+    std::size_t bytesPerPixel_;
+    std::size_t outputBytesPerPixel_;
+    unsigned sampleBits_;
+    OutputFormat output_;
+    std::size_t accumulateFrames_;
+    std::size_t spatialThreads_; // Requested; see Configure()
+    std::unique_ptr<WorkerPool> spatialWorkers_; // Null if single-threaded
+    std::shared_ptr<const LinearizationTable> linearization_; // May be null
+    std::vector<unsigned char> rowScratch_; // Three padded rows per thread
+    std::vector<double> phaseScratch_;
+    std::vector<uint32_t> binColumnSums_;
+    uint64_t phaseFramesSeen_; // Channel 0 frames since Configure()
+
+    bool linePhaseEnabled_;
+    std::atomic<int32_t> linePhase_; // Fixed point; see FramePipeline.cpp
+    std::atomic<int> phaseEstimateInterval_; // Frames; 0 disables
+
+    std::atomic<int> binningMode_;
+    std::atomic<int> conversion_;
+    std::atomic<int32_t> windowMin_;
+    std::atomic<int32_t> windowMax_;
+    std::atomic<int> medianFrames_;      // 1 disables
+    std::atomic<int32_t> recursiveGain_; // GAIN_ONE disables
+    std::atomic<int> spatialFilter_;
+
+    template <typename T> T *FlatFieldStage(Channel &c, T *in);
+    template <typename T>
+    T *LinePhaseStage(Channel &c, std::size_t chan, T *in);
+    template <typename T> T *LinearizationStage(Channel &c, T *in);
+    template <typename T> T *BinningStage(Channel &c, T *in);
+    template <typename T> T *TemporalMedianStage(Channel &c, T *in);
+    template <typename T> T *RecursiveFilterStage(Channel &c, T *in);
+    template <typename T> T *SpatialFilterStage(Channel &c, T *in);
+    void *ConvertTo8Bit(Channel &, uint8_t *in) { return in; }
+    void *ConvertTo8Bit(Channel &c, uint16_t *in);
+    template <typename T> uint32_t *AccumulateStage(Channel &c, T *in);
+    template <typename T> void *OutputStage(Channel &c, T *in);
+    template <typename T>
+    void *ProcessChannel(Channel &c, std::size_t chan, T *in);
+
+  public:
+    FramePipeline();
+
+    FramePipeline(const FramePipeline &) = delete;
+    FramePipeline &operator=(const FramePipeline &) = delete;
+
+    void Configure(const Config &config);
+
+    // Size of processed frames
+    std::size_t OutputBytes() const {
+        return width_ * height_ * outputBytesPerPixel_;
+    }
+
+    void SetBinningMode(BinningMode mode) { binningMode_ = mode; }
+    BinningMode GetBinningMode() const {
+        return static_cast<BinningMode>(binningMode_.load());
+    }
+
+    // Bidirectional scanning: odd rows are resampled at this offset (in
+    // pixels, interpolated) to line them up with even rows. With an
+    // estimate interval, the offset is re-estimated from every that many
+    // frames of channel 0, replacing the value set.
+    void SetLinePhase(double pixels);
+    double GetLinePhase() const;
+    void SetLinePhaseEstimateInterval(int frames);
+    int GetLinePhaseEstimateInterval() const {
+        return phaseEstimateInterval_;
+    }
+
+    // 8-bit output: the window is in sample values
+    void SetConversion(Conversion conversion) { conversion_ = conversion; }
+    Conversion GetConversion() const {
+        return static_cast<Conversion>(conversion_.load());
+    }
+    void SetWindowMin(int32_t min) { windowMin_ = min; }
+    void SetWindowMax(int32_t max) { windowMax_ = max; }
+    int32_t GetWindowMin() const { return windowMin_; }
+    int32_t GetWindowMax() const { return windowMax_; }
+
+    // Odd number of frames (up to MAX_MEDIAN_FRAMES) to take the per-pixel
+    // median over; 1 disables. Enabling it takes effect from the next
+    // Configure() if it was disabled at the last one.
+    void SetMedianFrames(int frames);
+    int GetMedianFrames() const { return medianFrames_; }
+
+    // Weight of the new frame in the running average (exponential moving
+    // average); 1 passes frames through
+    void SetRecursiveGain(double gain);
+    double GetRecursiveGain() const;
+
+    // Applied after the temporal filters; edges are replicated
+    void SetSpatialFilter(SpatialFilter filter);
+    SpatialFilter GetSpatialFilter() const {
+        return static_cast<SpatialFilter>(spatialFilter_.load());
+    }
+
+    // Returns the processed frame: either pixels or a buffer owned by the
+    // pipeline, valid until the next call for the same channel
+    void *Process(std::size_t chan, void *pixels);
+};
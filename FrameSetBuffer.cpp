@@ -0,0 +1,44 @@
+#include "FrameSetBuffer.h"
+
+#include <limits>
+#include <new>
+
+namespace {
+
+// Smallest page size in common use; touching more often is harmless
+const std::size_t PREFAULT_STRIDE = 4096;
+
+} // namespace
+
+bool FrameSetBuffer::Allocate(std::size_t slots, std::size_t channels,
+                              std::size_t imageBytes, bool prefault) {
+    Release();
+    if (slots == 0 || channels == 0 || imageBytes == 0)
+        return false;
+    const std::size_t maxSize = std::numeric_limits<std::size_t>::max();
+    if (channels > maxSize / imageBytes ||
+        slots > maxSize / (channels * imageBytes))
+        return false;
+
+    std::size_t bytes = slots * channels * imageBytes;
+    data_.reset(new (std::nothrow) unsigned char[bytes]);
+    if (!data_)
+        return false;
+    slots_ = slots;
+    channels_ = channels;
+    imageBytes_ = imageBytes;
+
+    if (prefault) {
+        volatile unsigned char *p = data_.get();
+        for (std::size_t i = 0; i < bytes; i += PREFAULT_STRIDE)
+            p[i] = 0;
+    }
+    return true;
+}
+
+void FrameSetBuffer::Release() {
+    data_.reset();
+    slots_ = 0;
+    channels_ = 0;
+    imageBytes_ = 0;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+// Preallocated, contiguous storage for a number of frame sets (one image per
+// channel), so that frames can be kept in memory at the cost of a memcpy.
+// Not thread-safe; slots are addressed by the caller.
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+
+class FrameSetBuffer {
+    std::unique_ptr<unsigned char[]> data_;
+    std::size_t slots_;
+    std::size_t channels_;
+    std::size_t imageBytes_;
+
+  public:
+    FrameSetBuffer() : slots_(0), channels_(0), imageBytes_(0) {}
+
+    FrameSetBuffer(const FrameSetBuffer &) = delete;
+    FrameSetBuffer &operator=(const FrameSetBuffer &) = delete;
+
+    // Returns false if the memory cannot be allocated. With prefault, every
+    // page is written up front so that storing frames does not fault.
+    bool Allocate(std::size_t slots, std::size_t channels,
+                  std::size_t imageBytes, bool prefault);
+    void Release();
+
+    bool Empty() const { return !data_; }
+    std::size_t Slots() const { return slots_; }
+    std::size_t Channels() const { return channels_; }
+    std::size_t ImageBytes() const { return imageBytes_; }
+    std::size_t Bytes() const { return slots_ * channels_ * imageBytes_; }
+
+    unsigned char *Image(std::size_t slot, std::size_t chan) {
+        return data_.get() + (slot * channels_ + chan) * imageBytes_;
+    }
+
+    void Store(std::size_t slot, std::size_t chan, const void *pixels) {
+        std::memcpy(Image(slot, chan), pixels, imageBytes_);
+    }
+};
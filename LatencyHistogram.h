@@ -0,0 +1,109 @@
+#pragma once
+
+// Log-bucketed (HDR-style) latency histogram with lock-free recording.
+//
+// Values are bucketed by power of two, with each power of two split into
+// SUB_BUCKETS linear sub-buckets, giving a relative precision of about
+// 1 / SUB_BUCKETS over the whole range. Record() may be called concurrently
+// from any thread; queries read a consistent-enough snapshot without
+// blocking writers.
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class LatencyHistogram {
+  public:
+    static const unsigned SUB_BUCKET_BITS = 5;
+    static const unsigned SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+    static const unsigned MAX_EXPONENT = 42; // ~73 minutes in ns
+    static const std::size_t NUM_BUCKETS =
+        (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+  private:
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets_;
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+
+    static unsigned Log2(uint64_t v) {
+        unsigned r = 0;
+        while (v >>= 1)
+            ++r;
+        return r;
+    }
+
+    static std::size_t BucketIndex(uint64_t value) {
+        if (value < SUB_BUCKETS)
+            return static_cast<std::size_t>(value);
+        unsigned exp = Log2(value);
+        if (exp > MAX_EXPONENT)
+            return NUM_BUCKETS - 1;
+        uint64_t sub = (value >> (exp - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+        return (exp - SUB_BUCKET_BITS + 1) * SUB_BUCKETS +
+               static_cast<std::size_t>(sub);
+    }
+
+    // Largest value that maps to the bucket
+    static uint64_t BucketUpperBound(std::size_t index) {
+        if (index < SUB_BUCKETS)
+            return index;
+        unsigned exp =
+            static_cast<unsigned>(index / SUB_BUCKETS) + SUB_BUCKET_BITS - 1;
+        uint64_t sub = index % SUB_BUCKETS;
+        uint64_t width = uint64_t(1) << (exp - SUB_BUCKET_BITS);
+        return (uint64_t(1) << exp) + (sub + 1) * width - 1;
+    }
+
+  public:
+    LatencyHistogram() { Reset(); }
+
+    // Not safe to call concurrently with Record()
+    void Reset() {
+        for (auto &b : buckets_)
+            b.store(0, std::memory_order_relaxed);
+        count_.store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    void Record(uint64_t valueNs) {
+        buckets_[BucketIndex(valueNs)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(valueNs, std::memory_order_relaxed);
+        uint64_t prevMax = max_.load(std::memory_order_relaxed);
+        while (valueNs > prevMax &&
+               !max_.compare_exchange_weak(prevMax, valueNs,
+                                           std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t SumNs() const { return sum_.load(std::memory_order_relaxed); }
+    uint64_t MaxNs() const { return max_.load(std::memory_order_relaxed); }
+
+    // Value at or below which the given percentage of samples fall (upper
+    // bound of the containing bucket, capped at the recorded maximum)
+    uint64_t PercentileNs(double percent) const {
+        uint64_t total = Count();
+        if (total == 0)
+            return 0;
+        uint64_t threshold =
+            static_cast<uint64_t>(percent / 100.0 * total + 0.5);
+        if (threshold < 1)
+            threshold = 1;
+        uint64_t cumulative = 0;
+        for (std::size_t i = 0; i < NUM_BUCKETS; ++i) {
+            cumulative += buckets_[i].load(std::memory_order_relaxed);
+            if (cumulative >= threshold) {
+                if (i == NUM_BUCKETS - 1) // Overflow bucket
+                    return MaxNs();
+                uint64_t upper = BucketUpperBound(i);
+                uint64_t max = MaxNs();
+                return upper < max ? upper : max;
+            }
+        }
+        return MaxNs();
+    }
+};
@@ -0,0 +1,93 @@
+#include "MetricsExporter.h"
+
+#include <cstdio>
+#include <utility>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+MetricsExporter::MetricsExporter(FormatFunction format, ErrorFunction onError)
+    : format_(std::move(format)), onError_(std::move(onError)),
+      interval_(0), stopRequested_(false) {}
+
+MetricsExporter::~MetricsExporter() { Stop(); }
+
+void MetricsExporter::Start(const std::string &path,
+                            std::chrono::milliseconds interval) {
+    Stop();
+    if (path.empty())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        path_ = path;
+        interval_ = interval;
+        stopRequested_ = false;
+    }
+    thread_ = std::thread(&MetricsExporter::Run, this);
+}
+
+void MetricsExporter::Stop() {
+    if (!thread_.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopRequested_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+void MetricsExporter::Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::string lastError;
+    while (!stopRequested_) {
+        std::string path = path_;
+        lock.unlock();
+
+        std::string errorMessage;
+        if (!WriteAtomically(path, format_(), errorMessage)) {
+            // Report each distinct error once rather than every interval
+            if (errorMessage != lastError)
+                onError_(errorMessage);
+            lastError = errorMessage;
+        } else {
+            lastError.clear();
+        }
+
+        lock.lock();
+        cv_.wait_for(lock, interval_, [this] { return stopRequested_; });
+    }
+}
+
+bool MetricsExporter::WriteAtomically(const std::string &path,
+                                      const std::string &contents,
+                                      std::string &errorMessage) {
+    const std::string tmpPath = path + ".tmp";
+    FILE *fp = std::fopen(tmpPath.c_str(), "wb");
+    if (!fp) {
+        errorMessage = "Cannot open metrics file for writing: " + tmpPath;
+        return false;
+    }
+    bool ok = std::fwrite(contents.data(), 1, contents.size(), fp) ==
+              contents.size();
+    ok = (std::fclose(fp) == 0) && ok;
+    if (!ok) {
+        errorMessage = "Error writing metrics file: " + tmpPath;
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    ok = MoveFileExA(tmpPath.c_str(), path.c_str(),
+                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    ok = std::rename(tmpPath.c_str(), path.c_str()) == 0;
+#endif
+    if (!ok) {
+        errorMessage = "Cannot replace metrics file: " + path;
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
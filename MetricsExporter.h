@@ -0,0 +1,50 @@
+#pragma once
+
+// Background writer of metrics in Prometheus text exposition format, for
+// collection by node_exporter's textfile collector.
+//
+// Every interval the exporter calls the format function and replaces the
+// output file atomically (write to a temporary file, then rename), so the
+// collector never sees a partial file.
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class MetricsExporter {
+  public:
+    typedef std::function<std::string()> FormatFunction;
+    typedef std::function<void(const std::string &)> ErrorFunction;
+
+  private:
+    FormatFunction format_;
+    ErrorFunction onError_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::string path_;
+    std::chrono::milliseconds interval_;
+    bool stopRequested_;
+    std::thread thread_;
+
+    void Run();
+
+  public:
+    MetricsExporter(FormatFunction format, ErrorFunction onError);
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter &) = delete;
+    MetricsExporter &operator=(const MetricsExporter &) = delete;
+
+    // Start (or restart) exporting to path; an empty path stops export
+    void Start(const std::string &path, std::chrono::milliseconds interval);
+    void Stop();
+
+    // Write the file once, synchronously. Returns false on error.
+    static bool WriteAtomically(const std::string &path,
+                                const std::string &contents,
+                                std::string &errorMessage);
+};
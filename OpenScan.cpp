@@ -1,10 +1,15 @@
 ﻿#include "OpenScan.h"
 
+#include "TraceRing.h"
+
 #include "ModuleInterface.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstdio>
 #include <cstring>
+#include <ctime>
 #include <iterator>
 #include <set>
 #include <sstream>
@@ -22,14 +27,160 @@ const char *const PROPERTY_Detector_Prefix = "Detector-";
 const char *const PROPERTY_EnableDetector_Prefix = "LSM-EnableDetector-";
 const char *const PROPERTY_Resolution = "Resolution";
 const char *const PROPERTY_Magnification = "Magnification";
+const char *const PROPERTY_TraceDumpFile = "LSM-TraceDumpFile";
+const char *const PROPERTY_CallbackLatency_Prefix = "LSM-CallbackLatencyUs-Ch";
+const char *const PROPERTY_MetricsFile = "LSM-MetricsFile";
+const char *const PROPERTY_MetricsIntervalMs = "LSM-MetricsIntervalMs";
+const char *const PROPERTY_ReportDirectory = "LSM-ReportDirectory";
+const char *const PROPERTY_DeviceLogLevel = "LSM-DeviceLogLevel";
+const char *const PROPERTY_DeviceLogRateLimit = "LSM-DeviceLogRateLimit";
+const char *const PROPERTY_StallTimeoutFactor = "LSM-StallTimeoutFactor";
+const char *const PROPERTY_StallRecovery = "LSM-StallRecovery";
+const char *const PROPERTY_AcquisitionState = "LSM-AcquisitionState";
+const char *const PROPERTY_TriggerMode = "LSM-TriggerMode";
+const char *const PROPERTY_SnapStartToFrameUs = "LSM-SnapStartToFrameUs";
+const char *const PROPERTY_PreArm = "LSM-PreArm";
+const char *const PROPERTY_PreArmDebounceMs = "LSM-PreArmDebounceMs";
+const char *const PROPERTY_PreArmCacheSize = "LSM-PreArmCacheSize";
+const char *const PROPERTY_BurstMode = "LSM-BurstMode";
+const char *const PROPERTY_BurstPrefault = "LSM-BurstPrefault";
+const char *const PROPERTY_BurstMaxMemoryMB = "LSM-BurstMaxMemoryMB";
+const char *const PROPERTY_PreTriggerSeconds = "LSM-PreTriggerSeconds";
+const char *const PROPERTY_PostTriggerSeconds = "LSM-PostTriggerSeconds";
+const char *const PROPERTY_PreTriggerMaxMemoryMB = "LSM-PreTriggerMaxMemoryMB";
+const char *const PROPERTY_CaptureDirectory = "LSM-CaptureDirectory";
+const char *const PROPERTY_Capture = "LSM-Capture";
+const char *const PROPERTY_SnapDuringLive = "LSM-SnapDuringLive";
+const char *const PROPERTY_TemporalMedianFrames = "LSM-TemporalMedianFrames";
+const char *const PROPERTY_RecursiveFilterGain = "LSM-RecursiveFilterGain";
+const char *const PROPERTY_SpatialFilter = "LSM-SpatialFilter";
+const char *const PROPERTY_LinePhaseOffset = "LSM-LinePhaseOffset";
+const char *const PROPERTY_LinePhaseEstimateInterval =
+    "LSM-LinePhaseEstimateInterval";
+const char *const PROPERTY_BinningMode = "LSM-BinningMode";
+const char *const PROPERTY_DetectorBitDepth = "LSM-DetectorBitDepth";
+const char *const PROPERTY_OutputBitDepth = "LSM-OutputBitDepth";
+const char *const PROPERTY_OutputConversion = "LSM-OutputConversion";
+const char *const PROPERTY_OutputWindowMin = "LSM-OutputWindowMin";
+const char *const PROPERTY_OutputWindowMax = "LSM-OutputWindowMax";
+const char *const PROPERTY_AccumulateFrames = "LSM-AccumulateFrames";
+const char *const PROPERTY_ScanTurnaroundUs = "LSM-ScanTurnaroundUs";
+const char *const PROPERTY_FlatFieldCorrection = "LSM-FlatFieldCorrection";
+const char *const PROPERTY_CalibrationDirectory = "LSM-CalibrationDirectory";
+const char *const PROPERTY_CalibrationFrames = "LSM-CalibrationFrames";
+const char *const PROPERTY_Calibrate = "LSM-Calibrate";
 
 const char *const VALUE_Yes = "Yes";
 const char *const VALUE_No = "No";
 
 const char *const VALUE_Unselected = "Unselected";
 
+const char *const VALUE_TriggerInternal = "Internal";
+const char *const VALUE_TriggerExternal = "External";
+
+const char *const VALUE_CaptureIdle = "Idle";
+const char *const VALUE_Capture = "Capture";
+
+const char *const VALUE_BinAverage = "Average";
+const char *const VALUE_BinSum = "Sum";
+
+const char *const VALUE_ConvertShift = "Shift";
+const char *const VALUE_ConvertWindow = "Window";
+
+const char *const VALUE_CalibrateIdle = "Idle";
+const char *const VALUE_CalibrateDark = "Dark";
+const char *const VALUE_CalibrateFlat = "Flat";
+
+// Image metadata of pre-trigger captures inserted into the core
+const char *const TAG_CaptureNumber = "CaptureNumber";
+const char *const TAG_CaptureFrameIndex = "CaptureFrameIndex";
+const char *const TAG_CaptureFrameCount = "CaptureFrameCount";
+
+const struct {
+    const char *name;
+    unsigned kinds; // Bit (1 << PreArmKind) per kind
+} PRE_ARM_MODES[] = {
+    {"None", 0},
+    {"Snap", 1u << PreArm_Snap},
+    {"Live", 1u << PreArm_Live},
+    {"Snap+Live", (1u << PreArm_Snap) | (1u << PreArm_Live)},
+};
+
+const long DEFAULT_PRE_ARM_DEBOUNCE_MS = 200;
+const long MAX_PRE_ARM_CACHE_SIZE = 4;
+
 const std::size_t MAX_DETECTOR_DEVICES = 4;
 
+const struct {
+    const char *suffix;
+    double percentile; // 100 means the maximum
+} LATENCY_STATS[] = {
+    {"P50", 50.0},   {"P90", 90.0},  {"P99", 99.0},
+    {"P99.9", 99.9}, {"Max", 100.0},
+};
+const long NUM_LATENCY_STATS =
+    sizeof(LATENCY_STATS) / sizeof(LATENCY_STATS[0]);
+
+const char *const SNAP_PHASE_NAMES[NUM_SNAP_PHASES] = {
+    "create", "arm", "start", "wait", "total",
+};
+
+const long DEFAULT_METRICS_INTERVAL_MS = 5000;
+
+const struct {
+    const char *name;
+    OSc_LogLevel level;
+} DEVICE_LOG_LEVELS[] = {
+    {"Debug", OSc_LogLevel_Debug},
+    {"Info", OSc_LogLevel_Info},
+    {"Warning", OSc_LogLevel_Warning},
+    {"Error", OSc_LogLevel_Error},
+};
+
+const long DEFAULT_DEVICE_LOG_RATE_LIMIT = 100; // Messages per second
+
+const long DEFAULT_BURST_MAX_MEMORY_MB = 4096;
+
+const char *const SNAP_DURING_LIVE_NAMES[] = {
+    "Busy",
+    "NextFrame",
+    "LatestFrame",
+};
+const int NUM_SNAP_DURING_LIVE_MODES =
+    sizeof(SNAP_DURING_LIVE_NAMES) / sizeof(SNAP_DURING_LIVE_NAMES[0]);
+
+const struct {
+    const char *name;
+    FramePipeline::SpatialFilter filter;
+} SPATIAL_FILTERS[] = {
+    {"None", FramePipeline::SpatialFilter_None},
+    {"Median3x3", FramePipeline::SpatialFilter_Median3x3},
+    {"Gaussian3x3", FramePipeline::SpatialFilter_Gaussian3x3},
+};
+
+const struct {
+    const char *name;
+    FramePipeline::OutputFormat format;
+} OUTPUT_FORMATS[] = {
+    {"Native", FramePipeline::OutputFormat_Native},
+    {"8", FramePipeline::OutputFormat_8Bit},
+    {"32 Mean", FramePipeline::OutputFormat_32BitMean},
+};
+
+const long DEFAULT_PRE_TRIGGER_MAX_MEMORY_MB = 4096;
+const double MAX_TRIGGER_WINDOW_SECONDS = 3600.0;
+// Live view rate while frames go to the pre-trigger ring
+const std::chrono::milliseconds PRE_TRIGGER_PREVIEW_INTERVAL(100);
+
+// Configurations (resolution, zoom, pixel rate) to keep tables for
+const std::size_t LINEARIZATION_CACHE_SIZE = 8;
+
+const long DEFAULT_CALIBRATION_FRAMES = 16;
+
+const double DEFAULT_STALL_TIMEOUT_FACTOR = 10.0;
+// Lower bound on the stall timeout, allowing for arming and line overhead
+const long MIN_STALL_TIMEOUT_MS = 2000;
+
 const int MIN_ADHOC_ERROR_CODE = 60001;
 const int MAX_ADHOC_ERROR_CODE = 70000;
 
@@ -62,7 +213,32 @@ MODULE_API void DeleteDevice(MM::Device *device) { delete device; }
 
 OpenScan::OpenScan()
     : nextAdHocErrorCode_(MIN_ADHOC_ERROR_CODE), oscLSM_(0), acqTemplate_(0),
-      sequenceAcquisition_(0), sequenceAcquisitionStopOnOverflow_(false) {
+      snappedImageBytes_(0), sequenceAcquisitionStopOnOverflow_(false),
+      sequenceFramesReceived_(0), queuedStartCount_(0),
+      queuedStartStopOnOverflow_(false), startQueued_(false),
+      teardownDelivers_(false), sequenceGeometry_(), busyOperations_(0),
+      templateChanges_(0), snapsInProgress_(0), preArmCache_(1),
+      preArmKinds_(0), preArmDebounceMs_(DEFAULT_PRE_ARM_DEBOUNCE_MS),
+      externalTrigger_(false), burstMode_(false), burstPrefault_(true),
+      burstMaxMemoryMB_(DEFAULT_BURST_MAX_MEMORY_MB), preTriggerSeconds_(0.0),
+      postTriggerSeconds_(0.0),
+      preTriggerMaxMemoryMB_(DEFAULT_PRE_TRIGGER_MAX_MEMORY_MB),
+      ringPreFrames_(0), ringPostFrames_(0), ringActive_(false),
+      captureRequested_(false), captureInProgress_(false),
+      ringResumeRequested_(false), captureCount_(0), ringStartFrame_(0),
+      ringFrozen_(false), capturePending_(false), captureStartFrame_(0),
+      captureEndFrame_(0), previewFrame_(false),
+      snapDuringLive_(SnapDuringLive_Busy), liveFramesOpen_(false),
+      liveFramesCompleted_(0), liveLatestSlot_(0), binning_(1),
+      detectorBitDepth_(0), outputFormat_(FramePipeline::OutputFormat_Native),
+      accumulateFrames_(1),
+      scanTurnaroundUs_(0.0),
+      linearizationTables_(LINEARIZATION_CACHE_SIZE),
+      flatFieldEnabled_(false), calibrationFrames_(DEFAULT_CALIBRATION_FRAMES),
+      calibrating_(false),
+      stallTimeoutFactor_(DEFAULT_STALL_TIMEOUT_FACTOR), stallRecovery_(false),
+      metricsIntervalMs_(DEFAULT_METRICS_INTERVAL_MS),
+      exportedFramesDelivered_(0) {
     const char *paths[] = {".", NULL};
     OSc_SetDeviceModuleSearchPaths(paths);
 
@@ -112,17 +288,23 @@ OpenScan::OpenScan()
     }
 }
 
-OpenScan::~OpenScan() {}
+OpenScan::~OpenScan() {
+    if (teardownWorker_)
+        teardownWorker_->Shutdown();
+    if (preArmDebouncer_)
+        preArmDebouncer_->Shutdown();
+    if (armWorker_)
+        armWorker_->Shutdown();
+    if (deviceLog_)
+        deviceLog_->Stop();
+}
 
 extern "C" {
+// May be called on any thread, including the acquisition thread
 static void LogOpenScan(const char *msg, OSc_LogLevel level, void *data) {
-    OpenScan *self = (OpenScan *)data;
-    self->LogOpenScanMessage(msg, level);
-}
+    auto *context = static_cast<OpenScan::DeviceLogContext *>(data);
+    context->queue->Post(context->source, msg, level);
 }
-
-void OpenScan::LogOpenScanMessage(const char *msg, OSc_LogLevel level) {
-    LogMessage(msg, level <= OSc_LogLevel_Info);
 }
 
 static void MagChangeCallback(OSc_Setting *, void *hub) {
@@ -175,11 +357,26 @@ int OpenScan::Initialize() {
         detectorDevices.push_back(detectorDevices_.at(detNam));
     }
 
-    OSc_Device_SetLogFunc(clockDevice, LogOpenScan, this);
-    OSc_Device_SetLogFunc(scannerDevice, LogOpenScan, this);
-    for (OSc_Device *det : detectorDevices) {
-        OSc_Device_SetLogFunc(det, LogOpenScan, this);
+    deviceLog_.reset(
+        new AsyncLogQueue([this](const std::string &msg, bool debugOnly) {
+            LogMessage(msg, debugOnly);
+        }));
+    deviceLog_->SetRateLimit(DEFAULT_DEVICE_LOG_RATE_LIMIT);
+    std::vector<OSc_Device *> logDevices{clockDevice, scannerDevice};
+    logDevices.insert(logDevices.end(), detectorDevices.begin(),
+                      detectorDevices.end());
+    std::set<OSc_Device *> loggingDevices;
+    for (OSc_Device *dev : logDevices) {
+        if (!loggingDevices.insert(dev).second)
+            continue;
+        const char *devName = "";
+        OSc_Device_GetName(dev, &devName);
+        deviceLogContexts_.emplace_back(new DeviceLogContext{
+            deviceLog_.get(), deviceLog_->AddSource(devName)});
+        OSc_Device_SetLogFunc(dev, LogOpenScan,
+                              deviceLogContexts_.back().get());
     }
+    deviceLog_->Start();
 
     err = OSc_Device_Open(clockDevice, oscLSM_);
     if (err != OSc_OK)
@@ -225,19 +422,111 @@ int OpenScan::Initialize() {
     OSc_Setting_SetInvalidateCallback(magSetting, MagChangeCallback,
                                       GetParentHub());
 
-    // Standard properties Exposure and Binning - not used for LSM
+    // Standard property Exposure - not used for LSM
     errCode = CreateFloatProperty(MM::g_Keyword_Exposure, 0.0, false);
     if (errCode != DEVICE_OK)
         return errCode;
     errCode = AddAllowedValue(MM::g_Keyword_Exposure, "0.0000");
     if (errCode != DEVICE_OK)
         return errCode;
-    errCode = CreateIntegerProperty(MM::g_Keyword_Binning, 1, false);
+
+    errCode = GenerateBinningProperties();
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+    errCode = GenerateOutputProperties();
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+    errCode = GenerateLatencyProperties();
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+    errCode = GenerateDeviceLogProperties();
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+    teardownWorker_.reset(new BackgroundWorker());
+    armWorker_.reset(new BackgroundWorker());
+    preArmDebouncer_.reset(new Debouncer([this] { PreArmInBackground(); },
+                                         std::chrono::milliseconds(
+                                             preArmDebounceMs_)));
+    stallWatchdog_.reset(
+        new StallWatchdog([this](std::chrono::milliseconds stalledFor) {
+            RecoverStalledAcquisition(stalledFor);
+        }));
+    errCode = GenerateStallWatchdogProperties();
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+    metricsExporter_.reset(new MetricsExporter(
+        [this] { return FormatPrometheusMetrics(); },
+        [this](const std::string &msg) { LogMessage(msg); }));
+    errCode = CreateStringProperty(
+        PROPERTY_MetricsFile, "", false,
+        new CPropertyAction(this, &OpenScan::OnMetricsFileProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = CreateIntegerProperty(
+        PROPERTY_MetricsIntervalMs, DEFAULT_METRICS_INTERVAL_MS, false,
+        new CPropertyAction(this, &OpenScan::OnMetricsIntervalProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    SetPropertyLimits(PROPERTY_MetricsIntervalMs, 100, 600000);
+
+    errCode = GenerateTriggerProperties();
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+    errCode = GeneratePreArmProperties();
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+    errCode = GenerateBurstProperties();
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+    errCode = GeneratePreTriggerProperties();
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+    errCode = GenerateSnapDuringLiveProperty();
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+    errCode = GenerateProcessingProperties();
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+    errCode = GenerateLinearizationProperties();
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+    errCode = GenerateCalibrationProperties();
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+    errCode = CreateStringProperty(
+        PROPERTY_AcquisitionState, AcquisitionStateName(AcqState_Idle), true,
+        new CPropertyAction(this, &OpenScan::OnAcquisitionStateProperty));
     if (errCode != DEVICE_OK)
         return errCode;
-    errCode = AddAllowedValue(MM::g_Keyword_Binning, "1");
+
+    // When set, a JSON report is written here at the end of each sequence
+    errCode = CreateStringProperty(
+        PROPERTY_ReportDirectory, "", false,
+        new CPropertyAction(this, &OpenScan::OnReportDirectoryProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+#ifdef OPENSCAN_MM_TRACE
+    // Setting a file path writes the recent trace events to that file
+    errCode = CreateStringProperty(
+        PROPERTY_TraceDumpFile, "", false,
+        new CPropertyAction(this, &OpenScan::OnTraceDumpFileProperty));
     if (errCode != DEVICE_OK)
         return errCode;
+#endif
 
     OpenScanHub *pHub = static_cast<OpenScanHub *>(GetParentHub());
     pHub->SetCameraDevice(this);
@@ -249,7 +538,20 @@ int OpenScan::Shutdown() {
     if (!oscLSM_)
         return DEVICE_OK;
 
+    if (metricsExporter_)
+        metricsExporter_->Stop();
+
     StopSequenceAcquisition();
+    if (stallWatchdog_)
+        stallWatchdog_->Shutdown();
+    // Wait for any teardown in progress
+    if (teardownWorker_)
+        teardownWorker_->Shutdown();
+    if (preArmDebouncer_)
+        preArmDebouncer_->Shutdown();
+    if (armWorker_)
+        armWorker_->Shutdown();
+    DiscardPreArmed(true);
 
     OpenScanHub *pHub = static_cast<OpenScanHub *>(GetParentHub());
     if (pHub)
@@ -258,6 +560,10 @@ int OpenScan::Shutdown() {
     OSc_LSM_Destroy(oscLSM_);
     oscLSM_ = 0;
 
+    // After the devices are closed, so that their final messages are logged
+    if (deviceLog_)
+        deviceLog_->Stop();
+
     return DEVICE_OK;
 }
 
@@ -520,135 +826,1415 @@ int OpenScan::GenerateProperties(OSc_Setting **settings, size_t count,
     return DEVICE_OK;
 }
 
-int OpenScan::GetMagnification(double *magnification) {
-    // We define magnification 1.0 as default resolution at Zoom 1.0.
-
-    OSc_RichError *err;
-    OSc_Setting *magSetting;
-    if (OSc_CHECK_ERROR(err, OSc_AcqTemplate_GetMagnificationSetting(
-                                 acqTemplate_, &magSetting))) {
-        return AdHocErrorCode(err);
+int OpenScan::GenerateLatencyProperties() {
+    // One set of properties per channel, with all detectors as enabled at
+    // initialization (channels beyond these are not recorded)
+    unsigned nChannels = GetNumberOfChannels();
+    for (unsigned chan = 0; chan < nChannels; ++chan) {
+        callbackLatency_.emplace_back(new LatencyHistogram());
+        for (long stat = 0; stat < NUM_LATENCY_STATS; ++stat) {
+            const std::string propName = PROPERTY_CallbackLatency_Prefix +
+                                         std::to_string(chan) + "-" +
+                                         LATENCY_STATS[stat].suffix;
+            CPropertyActionEx *handler = new CPropertyActionEx(
+                this, &OpenScan::OnCallbackLatencyProperty,
+                long(chan) * NUM_LATENCY_STATS + stat);
+            int errCode =
+                CreateFloatProperty(propName.c_str(), 0.0, true, handler);
+            if (errCode != DEVICE_OK)
+                return errCode;
+        }
     }
-    return AdHocErrorCode(
-        OSc_Setting_GetFloat64Value(magSetting, magnification));
+    return DEVICE_OK;
 }
 
-bool OpenScan::Busy() { return false; }
-
-void OpenScan::GetName(char *name) const {
-    CDeviceUtils::CopyLimitedString(name, DEVICE_NAME_Camera);
-}
+int OpenScan::GenerateDeviceLogProperties() {
+    int errCode = CreateStringProperty(
+        PROPERTY_DeviceLogLevel, DEVICE_LOG_LEVELS[0].name, false,
+        new CPropertyAction(this, &OpenScan::OnDeviceLogLevelProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    for (const auto &level : DEVICE_LOG_LEVELS) {
+        errCode = AddAllowedValue(PROPERTY_DeviceLogLevel, level.name);
+        if (errCode != DEVICE_OK)
+            return errCode;
+    }
 
-extern "C" {
-static bool SnapFrameCallback(OSc_Acquisition *acq, uint32_t chan,
-                              void *pixels, void *data) {
-    OpenScan *self = static_cast<OpenScan *>(data);
-    self->StoreSnapImage(acq, chan, pixels);
-    return true;
-}
+    // Per device, messages per second; 0 disables rate limiting. Warnings
+    // and errors are never rate limited.
+    errCode = CreateIntegerProperty(
+        PROPERTY_DeviceLogRateLimit, DEFAULT_DEVICE_LOG_RATE_LIMIT, false,
+        new CPropertyAction(this, &OpenScan::OnDeviceLogRateLimitProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    return SetPropertyLimits(PROPERTY_DeviceLogRateLimit, 0, 100000);
 }
 
-int OpenScan::SnapImage() {
-    if (IsCapturing())
-        return DEVICE_CAMERA_BUSY_ACQUIRING;
-
-    DiscardPreviouslySnappedImages();
+int OpenScan::GenerateTriggerProperties() {
+    // In External mode a snap acquisition is kept armed, so that the frame
+    // starts as soon as the clock device's trigger arrives. The clock device
+    // must itself be configured (through its own settings) to wait for an
+    // external trigger.
+    int errCode = CreateStringProperty(
+        PROPERTY_TriggerMode, VALUE_TriggerInternal, false,
+        new CPropertyAction(this, &OpenScan::OnTriggerModeProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = AddAllowedValue(PROPERTY_TriggerMode, VALUE_TriggerInternal);
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = AddAllowedValue(PROPERTY_TriggerMode, VALUE_TriggerExternal);
+    if (errCode != DEVICE_OK)
+        return errCode;
 
-    OSc_Acquisition *acq;
-    OSc_RichError *err = OSc_Acquisition_Create(&acq, acqTemplate_);
-    if (err)
-        return AdHocErrorCode(err);
+    // Time from starting the last snap to its frame arriving, which includes
+    // waiting for the trigger and scanning the frame
+    return CreateFloatProperty(
+        PROPERTY_SnapStartToFrameUs, 0.0, true,
+        new CPropertyAction(this, &OpenScan::OnSnapStartToFrameProperty));
+}
 
-    err = OSc_Acquisition_SetData(acq, this);
-    if (err)
-        goto error;
+int OpenScan::GeneratePreArmProperties() {
+    // Which acquisitions to arm in the background once settings have been
+    // quiet for the debounce delay. Snaps are always pre-armed in external
+    // trigger mode.
+    int errCode = CreateStringProperty(
+        PROPERTY_PreArm, PRE_ARM_MODES[0].name, false,
+        new CPropertyAction(this, &OpenScan::OnPreArmProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    for (const auto &mode : PRE_ARM_MODES) {
+        errCode = AddAllowedValue(PROPERTY_PreArm, mode.name);
+        if (errCode != DEVICE_OK)
+            return errCode;
+    }
 
-    err = OSc_Acquisition_SetNumberOfFrames(acq, 1);
-    if (err)
-        goto error;
+    errCode = CreateIntegerProperty(
+        PROPERTY_PreArmDebounceMs, DEFAULT_PRE_ARM_DEBOUNCE_MS, false,
+        new CPropertyAction(this, &OpenScan::OnPreArmDebounceProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = SetPropertyLimits(PROPERTY_PreArmDebounceMs, 0, 10000);
+    if (errCode != DEVICE_OK)
+        return errCode;
 
-    err = OSc_Acquisition_SetFrameCallback(acq, SnapFrameCallback);
-    if (err)
-        goto error;
+    // Number of armed configurations kept. Values above 1 require devices
+    // that accept several armed acquisitions, and setting changes while
+    // armed.
+    errCode = CreateIntegerProperty(
+        PROPERTY_PreArmCacheSize, 1, false,
+        new CPropertyAction(this, &OpenScan::OnPreArmCacheSizeProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    return SetPropertyLimits(PROPERTY_PreArmCacheSize, 1,
+                             MAX_PRE_ARM_CACHE_SIZE);
+}
 
-    err = OSc_Acquisition_Arm(acq);
-    if (err)
-        goto error;
+int OpenScan::GenerateBurstProperties() {
+    // When enabled, sequences with a frame count are kept in memory during
+    // the scan and inserted into the core when it is done
+    int errCode = CreateStringProperty(
+        PROPERTY_BurstMode, VALUE_No, false,
+        new CPropertyAction(this, &OpenScan::OnBurstModeProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = AddAllowedValue(PROPERTY_BurstMode, VALUE_Yes);
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = AddAllowedValue(PROPERTY_BurstMode, VALUE_No);
+    if (errCode != DEVICE_OK)
+        return errCode;
 
-    err = OSc_Acquisition_Start(acq);
-    if (err)
-        goto error;
+    // Whether to touch every page of the burst buffer before the scan
+    errCode = CreateStringProperty(
+        PROPERTY_BurstPrefault, VALUE_Yes, false,
+        new CPropertyAction(this, &OpenScan::OnBurstPrefaultProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = AddAllowedValue(PROPERTY_BurstPrefault, VALUE_Yes);
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = AddAllowedValue(PROPERTY_BurstPrefault, VALUE_No);
+    if (errCode != DEVICE_OK)
+        return errCode;
 
-    err = OSc_Acquisition_Wait(acq);
-    if (err)
-        goto error;
+    // Larger bursts fail to start rather than exhaust memory
+    errCode = CreateIntegerProperty(
+        PROPERTY_BurstMaxMemoryMB, DEFAULT_BURST_MAX_MEMORY_MB, false,
+        new CPropertyAction(this, &OpenScan::OnBurstMaxMemoryProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    return SetPropertyLimits(PROPERTY_BurstMaxMemoryMB, 1, 1 << 20);
+}
 
-    OSc_Acquisition_Destroy(acq);
+int OpenScan::GeneratePreTriggerProperties() {
+    // Seconds of live frames to keep in memory; 0 disables the ring
+    int errCode = CreateFloatProperty(
+        PROPERTY_PreTriggerSeconds, 0.0, false,
+        new CPropertyAction(this, &OpenScan::OnPreTriggerSecondsProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = SetPropertyLimits(PROPERTY_PreTriggerSeconds, 0.0,
+                                MAX_TRIGGER_WINDOW_SECONDS);
+    if (errCode != DEVICE_OK)
+        return errCode;
 
-    return DEVICE_OK;
+    // Seconds of frames after a capture request to include in the capture
+    errCode = CreateFloatProperty(
+        PROPERTY_PostTriggerSeconds, 0.0, false,
+        new CPropertyAction(this, &OpenScan::OnPostTriggerSecondsProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = SetPropertyLimits(PROPERTY_PostTriggerSeconds, 0.0,
+                                MAX_TRIGGER_WINDOW_SECONDS);
+    if (errCode != DEVICE_OK)
+        return errCode;
 
-error:
-    int errCode = AdHocErrorCode(err);
-    OSc_Acquisition_Destroy(acq);
-    return errCode;
-}
+    errCode = CreateIntegerProperty(
+        PROPERTY_PreTriggerMaxMemoryMB, DEFAULT_PRE_TRIGGER_MAX_MEMORY_MB,
+        false,
+        new CPropertyAction(this, &OpenScan::OnPreTriggerMaxMemoryProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = SetPropertyLimits(PROPERTY_PreTriggerMaxMemoryMB, 1, 1 << 20);
+    if (errCode != DEVICE_OK)
+        return errCode;
 
-void OpenScan::StoreSnapImage(OSc_Acquisition *, uint32_t chan, void *pixels) {
-    size_t bufSize = GetImageBufferSize();
-    void *buffer = malloc(bufSize);
-    memcpy(buffer, pixels, bufSize);
+    // When set, captures are written here as raw files instead of being
+    // inserted into the core
+    errCode = CreateStringProperty(
+        PROPERTY_CaptureDirectory, "", false,
+        new CPropertyAction(this, &OpenScan::OnCaptureDirectoryProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
 
-    if (snappedImages_.size() < chan + 1)
-        snappedImages_.resize(chan + 1, 0);
-    if (snappedImages_[chan])
-        free(snappedImages_[chan]);
-    snappedImages_[chan] = buffer;
+    // Setting Capture starts a capture; reads Capture until it is written
+    errCode = CreateStringProperty(
+        PROPERTY_Capture, VALUE_CaptureIdle, false,
+        new CPropertyAction(this, &OpenScan::OnCaptureProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = AddAllowedValue(PROPERTY_Capture, VALUE_CaptureIdle);
+    if (errCode != DEVICE_OK)
+        return errCode;
+    return AddAllowedValue(PROPERTY_Capture, VALUE_Capture);
 }
 
-void OpenScan::DiscardPreviouslySnappedImages() {
-    for (std::vector<void *>::iterator it = snappedImages_.begin(),
-                                       end = snappedImages_.end();
-         it != end; ++it) {
-        if (*it)
-            free(*it);
+int OpenScan::GenerateSnapDuringLiveProperty() {
+    // What SnapImage does while a sequence runs: refuse, or return the next
+    // (or the most recent) complete frame set without interrupting it
+    int errCode = CreateStringProperty(
+        PROPERTY_SnapDuringLive, SNAP_DURING_LIVE_NAMES[SnapDuringLive_Busy],
+        false, new CPropertyAction(this, &OpenScan::OnSnapDuringLiveProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    for (const char *name : SNAP_DURING_LIVE_NAMES) {
+        errCode = AddAllowedValue(PROPERTY_SnapDuringLive, name);
+        if (errCode != DEVICE_OK)
+            return errCode;
     }
-    snappedImages_.clear();
+    return DEVICE_OK;
 }
 
-const unsigned char *OpenScan::GetImageBuffer(unsigned chan) {
-    if (chan >= GetNumberOfChannels() || chan >= snappedImages_.size())
-        return 0;
-    return reinterpret_cast<unsigned char *>(snappedImages_[chan]);
-}
+int OpenScan::GenerateProcessingProperties() {
+    // Bidirectional scanning: shift (pixels) applied to odd lines of
+    // sequence frames to line them up with even lines
+    int errCode = CreateFloatProperty(
+        PROPERTY_LinePhaseOffset, 0.0, false,
+        new CPropertyAction(this, &OpenScan::OnLinePhaseOffsetProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = SetPropertyLimits(PROPERTY_LinePhaseOffset,
+                                -FramePipeline::MAX_PHASE_SHIFT,
+                                FramePipeline::MAX_PHASE_SHIFT);
+    if (errCode != DEVICE_OK)
+        return errCode;
 
-long OpenScan::GetImageBufferSize() const {
-    return GetImageWidth() * GetImageHeight() * GetImageBytesPerPixel();
-}
+    // Re-estimate the line phase offset from every this many frames, by
+    // cross-correlating adjacent lines; 0 keeps the offset fixed
+    errCode = CreateIntegerProperty(
+        PROPERTY_LinePhaseEstimateInterval, 0, false,
+        new CPropertyAction(this,
+                            &OpenScan::OnLinePhaseEstimateIntervalProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = SetPropertyLimits(PROPERTY_LinePhaseEstimateInterval, 0, 10000);
+    if (errCode != DEVICE_OK)
+        return errCode;
 
-unsigned OpenScan::GetImageWidth() const {
-    uint32_t xOffset, yOffset, width, height;
-    OSc_AcqTemplate_GetROI(acqTemplate_, &xOffset, &yOffset, &width, &height);
-    return width;
-}
+    // Number of frames to take the per-pixel median over, removing
+    // single-frame spikes; 1 disables the median
+    errCode = CreateIntegerProperty(
+        PROPERTY_TemporalMedianFrames, 1, false,
+        new CPropertyAction(this, &OpenScan::OnTemporalMedianProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    for (int frames = 1; frames <= FramePipeline::MAX_MEDIAN_FRAMES;
+         frames += 2) {
+        errCode = AddAllowedValue(PROPERTY_TemporalMedianFrames,
+                                  std::to_string(frames).c_str());
+        if (errCode != DEVICE_OK)
+            return errCode;
+    }
 
-unsigned OpenScan::GetImageHeight() const {
-    uint32_t xOffset, yOffset, width, height;
-    OSc_AcqTemplate_GetROI(acqTemplate_, &xOffset, &yOffset, &width, &height);
-    return height;
-}
+    // Weight of each new sequence frame in a per-pixel running average, for
+    // denoising live images; 1 disables averaging
+    errCode = CreateFloatProperty(
+        PROPERTY_RecursiveFilterGain, 1.0, false,
+        new CPropertyAction(this, &OpenScan::OnRecursiveFilterGainProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = SetPropertyLimits(PROPERTY_RecursiveFilterGain, 0.01, 1.0);
+    if (errCode != DEVICE_OK)
+        return errCode;
 
-unsigned OpenScan::GetImageBytesPerPixel() const {
-    uint32_t bps;
-    OSc_AcqTemplate_GetBytesPerSample(acqTemplate_, &bps);
-    return bps;
+    // Applied to each sequence frame after the temporal filters
+    errCode = CreateStringProperty(
+        PROPERTY_SpatialFilter, SPATIAL_FILTERS[0].name, false,
+        new CPropertyAction(this, &OpenScan::OnSpatialFilterProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    for (const auto &filter : SPATIAL_FILTERS) {
+        errCode = AddAllowedValue(PROPERTY_SpatialFilter, filter.name);
+        if (errCode != DEVICE_OK)
+            return errCode;
+    }
+    return DEVICE_OK;
 }
 
-unsigned OpenScan::GetNumberOfComponents() const { return 1; }
+int OpenScan::GenerateBinningProperties() {
+    // Done in software, after the scan: the scanner keeps its sampling
+    // density and images get smaller
+    int errCode = CreateIntegerProperty(
+        MM::g_Keyword_Binning, 1, false,
+        new CPropertyAction(this, &OpenScan::OnBinningProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    for (unsigned binning = 1; binning <= FramePipeline::MAX_BINNING;
+         binning *= 2) {
+        errCode = AddAllowedValue(MM::g_Keyword_Binning,
+                                  std::to_string(binning).c_str());
+        if (errCode != DEVICE_OK)
+            return errCode;
+    }
 
-unsigned OpenScan::GetNumberOfChannels() const {
-    uint32_t nChannels;
-    OSc_AcqTemplate_GetNumberOfChannels(acqTemplate_, &nChannels);
-    return nChannels;
+    // Sum saturates at the maximum sample value
+    errCode = CreateStringProperty(
+        PROPERTY_BinningMode, VALUE_BinAverage, false,
+        new CPropertyAction(this, &OpenScan::OnBinningModeProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = AddAllowedValue(PROPERTY_BinningMode, VALUE_BinAverage);
+    if (errCode != DEVICE_OK)
+        return errCode;
+    return AddAllowedValue(PROPERTY_BinningMode, VALUE_BinSum);
+}
+
+int OpenScan::GenerateOutputProperties() {
+    // Significant bits of detector samples, for devices that produce fewer
+    // than OpenScanLib's sample size; 0 for all of them
+    int errCode = CreateIntegerProperty(
+        PROPERTY_DetectorBitDepth, 0, false,
+        new CPropertyAction(this, &OpenScan::OnDetectorBitDepthProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = SetPropertyLimits(PROPERTY_DetectorBitDepth, 0, 16);
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+    // 8 converts 16-bit samples to 8-bit pixels; 32 delivers float means of
+    // accumulated frames
+    errCode = CreateStringProperty(
+        PROPERTY_OutputBitDepth, OUTPUT_FORMATS[0].name, false,
+        new CPropertyAction(this, &OpenScan::OnOutputBitDepthProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    for (const auto &output : OUTPUT_FORMATS) {
+        errCode = AddAllowedValue(PROPERTY_OutputBitDepth, output.name);
+        if (errCode != DEVICE_OK)
+            return errCode;
+    }
+
+    // For 32-bit output: each image covers this many frames, and each snap
+    // scans them all
+    errCode = CreateIntegerProperty(
+        PROPERTY_AccumulateFrames, 1, false,
+        new CPropertyAction(this, &OpenScan::OnAccumulateFramesProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = SetPropertyLimits(PROPERTY_AccumulateFrames, 1,
+                                FramePipeline::MAX_ACCUMULATE_FRAMES);
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+    // Shift keeps the top 8 detector bits; Window maps the window linearly
+    errCode = CreateStringProperty(
+        PROPERTY_OutputConversion, VALUE_ConvertShift, false,
+        new CPropertyAction(this, &OpenScan::OnOutputConversionProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    for (const char *value : {VALUE_ConvertShift, VALUE_ConvertWindow}) {
+        errCode = AddAllowedValue(PROPERTY_OutputConversion, value);
+        if (errCode != DEVICE_OK)
+            return errCode;
+    }
+
+    errCode = CreateIntegerProperty(
+        PROPERTY_OutputWindowMin, 0, false,
+        new CPropertyAction(this, &OpenScan::OnOutputWindowMinProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = SetPropertyLimits(PROPERTY_OutputWindowMin, 0, UINT16_MAX);
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = CreateIntegerProperty(
+        PROPERTY_OutputWindowMax, UINT16_MAX, false,
+        new CPropertyAction(this, &OpenScan::OnOutputWindowMaxProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    return SetPropertyLimits(PROPERTY_OutputWindowMax, 0, UINT16_MAX);
+}
+
+int OpenScan::GenerateLinearizationProperties() {
+    // Time at each end of a line during which the scanner is still
+    // accelerating; images are resampled to uniform pixel spacing
+    int errCode = CreateFloatProperty(
+        PROPERTY_ScanTurnaroundUs, 0.0, false,
+        new CPropertyAction(this, &OpenScan::OnScanTurnaroundProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    return SetPropertyLimits(PROPERTY_ScanTurnaroundUs, 0.0, 10000.0);
+}
+
+int OpenScan::GenerateCalibrationProperties() {
+    // Apply (raw - dark) * gain, from the references for the current
+    // configuration, to snapped and sequence frames
+    int errCode = CreateStringProperty(
+        PROPERTY_FlatFieldCorrection, VALUE_No, false,
+        new CPropertyAction(this, &OpenScan::OnFlatFieldCorrectionProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = AddAllowedValue(PROPERTY_FlatFieldCorrection, VALUE_No);
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = AddAllowedValue(PROPERTY_FlatFieldCorrection, VALUE_Yes);
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+    // Where references are written and read
+    errCode = CreateStringProperty(
+        PROPERTY_CalibrationDirectory, "", false,
+        new CPropertyAction(this, &OpenScan::OnCalibrationDirectoryProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+    errCode = CreateIntegerProperty(
+        PROPERTY_CalibrationFrames, DEFAULT_CALIBRATION_FRAMES, false,
+        new CPropertyAction(this, &OpenScan::OnCalibrationFramesProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = SetPropertyLimits(PROPERTY_CalibrationFrames, 1, 1000);
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+    // Setting Dark or Flat acquires that reference (returning when done)
+    errCode = CreateStringProperty(
+        PROPERTY_Calibrate, VALUE_CalibrateIdle, false,
+        new CPropertyAction(this, &OpenScan::OnCalibrateProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    for (const char *value :
+         {VALUE_CalibrateIdle, VALUE_CalibrateDark, VALUE_CalibrateFlat}) {
+        errCode = AddAllowedValue(PROPERTY_Calibrate, value);
+        if (errCode != DEVICE_OK)
+            return errCode;
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::GenerateStallWatchdogProperties() {
+    // A sequence acquisition is considered stalled when no frame arrives for
+    // this multiple of the expected frame period; 0 disables the watchdog
+    int errCode = CreateFloatProperty(
+        PROPERTY_StallTimeoutFactor, DEFAULT_STALL_TIMEOUT_FACTOR, false,
+        new CPropertyAction(this, &OpenScan::OnStallTimeoutFactorProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = SetPropertyLimits(PROPERTY_StallTimeoutFactor, 0.0, 1000.0);
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+    // Whether to restart a stalled acquisition automatically
+    errCode = CreateStringProperty(
+        PROPERTY_StallRecovery, VALUE_No, false,
+        new CPropertyAction(this, &OpenScan::OnStallRecoveryProperty));
+    if (errCode != DEVICE_OK)
+        return errCode;
+    errCode = AddAllowedValue(PROPERTY_StallRecovery, VALUE_Yes);
+    if (errCode != DEVICE_OK)
+        return errCode;
+    return AddAllowedValue(PROPERTY_StallRecovery, VALUE_No);
+}
+
+namespace {
+
+void AppendMetricHeader(std::ostringstream &out, const char *name,
+                        const char *type, const char *help) {
+    out << "# HELP " << name << ' ' << help << '\n';
+    out << "# TYPE " << name << ' ' << type << '\n';
+}
+
+template <typename T>
+void AppendMetric(std::ostringstream &out, const char *name, const char *type,
+                  const char *help, T value) {
+    AppendMetricHeader(out, name, type, help);
+    out << name << ' ' << value << '\n';
+}
+
+} // namespace
+
+// Called on the metrics exporter thread; must only read state that is safe
+// to access concurrently with acquisition.
+std::string OpenScan::FormatPrometheusMetrics() {
+    std::ostringstream out;
+
+    AppendMetric(out, "openscan_acquisition_running", "gauge",
+                 "Whether a sequence acquisition is running.",
+                 metrics_.sequenceRunning ? 1 : 0);
+    // One series per state, 1 for the current one
+    const char *stateName = "openscan_acquisition_state";
+    AppendMetricHeader(out, stateName, "gauge",
+                       "State of the sequence acquisition.");
+    AcquisitionState state = sequenceState_.State();
+    for (int s = 0; s < NUM_ACQ_STATES; ++s) {
+        out << stateName << "{state=\""
+            << AcquisitionStateName(AcquisitionState(s)) << "\"} "
+            << (s == state ? 1 : 0) << '\n';
+    }
+    AppendMetric(out, "openscan_sequences_started_total", "counter",
+                 "Sequence acquisitions started.",
+                 metrics_.sequencesStarted.load());
+
+    uint64_t frames = metrics_.framesDelivered;
+    auto now = std::chrono::steady_clock::now();
+    double fps = 0.0;
+    if (exportedTime_.time_since_epoch().count() != 0) {
+        double seconds =
+            std::chrono::duration<double>(now - exportedTime_).count();
+        if (seconds > 0.0)
+            fps = (frames - exportedFramesDelivered_) / seconds;
+    }
+    exportedFramesDelivered_ = frames;
+    exportedTime_ = now;
+    AppendMetric(out, "openscan_frames_delivered_total", "counter",
+                 "Sequence frames (channel 0) delivered to the core.", frames);
+    AppendMetric(out, "openscan_frame_rate_fps", "gauge",
+                 "Sequence frame rate over the last export interval.", fps);
+    AppendMetric(out, "openscan_images_inserted_total", "counter",
+                 "Sequence images (all channels) inserted into the core.",
+                 metrics_.imagesInserted.load());
+    AppendMetric(out, "openscan_images_dropped_total", "counter",
+                 "Sequence images that could not be inserted.",
+                 metrics_.imagesDropped.load());
+    AppendMetric(out, "openscan_buffer_overflows_total", "counter",
+                 "Core sequence buffer overflow events.",
+                 metrics_.overflowEvents.load());
+    AppendMetric(out, "openscan_acquisition_stalls_total", "counter",
+                 "Sequence acquisitions that stopped delivering frames.",
+                 metrics_.acquisitionStalls.load());
+    AppendMetric(out, "openscan_acquisition_recoveries_total", "counter",
+                 "Stalled sequence acquisitions restarted automatically.",
+                 metrics_.acquisitionRecoveries.load());
+
+    const char *latencyName = "openscan_callback_latency_seconds";
+    AppendMetricHeader(out, latencyName, "summary",
+                       "Frame callback to InsertImage return latency in the "
+                       "current or last sequence.");
+    for (std::size_t chan = 0; chan < callbackLatency_.size(); ++chan) {
+        const LatencyHistogram &hist = *callbackLatency_[chan];
+        for (const auto &stat : LATENCY_STATS) {
+            if (stat.percentile >= 100.0)
+                continue;
+            out << latencyName << "{channel=\"" << chan << "\",quantile=\""
+                << stat.percentile / 100.0 << "\"} "
+                << hist.PercentileNs(stat.percentile) * 1e-9 << '\n';
+        }
+        out << latencyName << "_sum{channel=\"" << chan << "\"} "
+            << hist.SumNs() * 1e-9 << '\n';
+        out << latencyName << "_count{channel=\"" << chan << "\"} "
+            << hist.Count() << '\n';
+    }
+    const char *latencyMaxName = "openscan_callback_latency_max_seconds";
+    AppendMetricHeader(out, latencyMaxName, "gauge",
+                       "Maximum frame callback to InsertImage return latency "
+                       "in the current or last sequence.");
+    for (std::size_t chan = 0; chan < callbackLatency_.size(); ++chan) {
+        out << latencyMaxName << "{channel=\"" << chan << "\"} "
+            << callbackLatency_[chan]->MaxNs() * 1e-9 << '\n';
+    }
+
+    AppendMetric(out, "openscan_buffer_bytes_in_use", "gauge",
+                 "Image memory held by the adapter.",
+                 metrics_.bufferBytesInUse.load());
+
+    AppendMetric(out, "openscan_snaps_total", "counter", "Snaps completed.",
+                 metrics_.snaps.load());
+    AppendMetric(out, "openscan_pre_arm_hits_total", "counter",
+                 "Snaps and live starts that used a pre-armed acquisition.",
+                 metrics_.preArmHits.load());
+    AppendMetric(out, "openscan_pre_arm_misses_total", "counter",
+                 "Snaps and live starts that had to arm while pre-arming "
+                 "was enabled.",
+                 metrics_.preArmMisses.load());
+    const char *startToFrameName = "openscan_snap_start_to_frame_seconds";
+    AppendMetricHeader(out, startToFrameName, "summary",
+                       "Time from snap start to frame arrival, including "
+                       "waiting for an external trigger.");
+    for (const auto &stat : LATENCY_STATS) {
+        if (stat.percentile >= 100.0)
+            continue;
+        out << startToFrameName << "{quantile=\"" << stat.percentile / 100.0
+            << "\"} " << snapStartToFrame_.PercentileNs(stat.percentile) * 1e-9
+            << '\n';
+    }
+    out << startToFrameName << "_sum " << snapStartToFrame_.SumNs() * 1e-9
+        << '\n';
+    out << startToFrameName << "_count " << snapStartToFrame_.Count() << '\n';
+    const char *snapPhaseName = "openscan_last_snap_phase_seconds";
+    AppendMetricHeader(out, snapPhaseName, "gauge",
+                       "Duration of each phase of the last completed snap.");
+    for (int phase = 0; phase < NUM_SNAP_PHASES; ++phase) {
+        out << snapPhaseName << "{phase=\"" << SNAP_PHASE_NAMES[phase]
+            << "\"} " << metrics_.lastSnapPhaseNs[phase] * 1e-9 << '\n';
+    }
+
+    AppendMetric(out, "openscan_errors_total", "counter",
+                 "Errors reported by the adapter.", metrics_.errors.load());
+
+    return out.str();
+}
+
+namespace {
+
+OSc_RichError *FormatSettingValue(OSc_Setting *setting, std::string &value) {
+    OSc_ValueType valueType;
+    OSc_RichError *err = OSc_Setting_GetValueType(setting, &valueType);
+    if (err != OSc_OK)
+        return err;
+    char buf[OSc_MAX_STR_LEN + 1] = {};
+    switch (valueType) {
+    case OSc_ValueType_String:
+        err = OSc_Setting_GetStringValue(setting, buf);
+        break;
+    case OSc_ValueType_Bool: {
+        bool v;
+        err = OSc_Setting_GetBoolValue(setting, &v);
+        snprintf(buf, sizeof(buf), "%s", v ? VALUE_Yes : VALUE_No);
+        break;
+    }
+    case OSc_ValueType_Int32: {
+        int32_t v;
+        err = OSc_Setting_GetInt32Value(setting, &v);
+        snprintf(buf, sizeof(buf), "%d", v);
+        break;
+    }
+    case OSc_ValueType_Float64: {
+        double v;
+        err = OSc_Setting_GetFloat64Value(setting, &v);
+        snprintf(buf, sizeof(buf), "%g", v);
+        break;
+    }
+    case OSc_ValueType_Enum: {
+        uint32_t v;
+        err = OSc_Setting_GetEnumValue(setting, &v);
+        if (err == OSc_OK)
+            err = OSc_Setting_GetEnumNameForValue(setting, v, buf);
+        break;
+    }
+    }
+    value = buf;
+    return err;
+}
+
+std::string LocalTimeString(const char *format) {
+    std::time_t now = std::time(nullptr);
+    std::tm tm;
+#ifdef _WIN32
+    localtime_s(&tm, &now);
+#else
+    localtime_r(&now, &tm);
+#endif
+    char buf[64];
+    std::strftime(buf, sizeof(buf), format, &tm);
+    return buf;
+}
+
+} // namespace
+
+std::string OpenScan::CaptureAcquisitionConfig(AcquisitionReport &report) {
+    report.startTime = LocalTimeString("%Y-%m-%dT%H:%M:%S");
+
+    OSc_RichError *err;
+    OSc_Setting *acqSettings[3];
+    if (OSc_CHECK_ERROR(err, OSc_AcqTemplate_GetPixelRateSetting(
+                                 acqTemplate_, &acqSettings[0])) ||
+        OSc_CHECK_ERROR(err, OSc_AcqTemplate_GetResolutionSetting(
+                                 acqTemplate_, &acqSettings[1])) ||
+        OSc_CHECK_ERROR(err, OSc_AcqTemplate_GetZoomFactorSetting(
+                                 acqTemplate_, &acqSettings[2]))) {
+        return FormatRichError(err);
+    }
+    for (OSc_Setting *setting : acqSettings) {
+        char name[OSc_MAX_STR_LEN + 1];
+        std::string value;
+        if (OSc_CHECK_ERROR(err, OSc_Setting_GetName(setting, name)) ||
+            OSc_CHECK_ERROR(err, FormatSettingValue(setting, value))) {
+            return FormatRichError(err);
+        }
+        report.settings.emplace_back(name, value);
+    }
+
+    if (OSc_CHECK_ERROR(err, OSc_AcqTemplate_GetROI(
+                                 acqTemplate_, &report.roiX, &report.roiY,
+                                 &report.roiWidth, &report.roiHeight))) {
+        return FormatRichError(err);
+    }
+
+    for (std::size_t i = 0; i < OSc_LSM_GetNumberOfDetectorDevices(oscLSM_);
+         ++i) {
+        const char *devName;
+        if (OSc_CHECK_ERROR(err, OSc_Device_GetName(
+                                     OSc_LSM_GetDetectorDevice(oscLSM_, i),
+                                     &devName))) {
+            return FormatRichError(err);
+        }
+        report.detectors.emplace_back(
+            devName, OSc_AcqTemplate_IsDetectorDeviceEnabled(acqTemplate_, i));
+    }
+
+    report.numChannels = GetNumberOfChannels();
+    report.bytesPerPixel = GetImageBytesPerPixel();
+    return std::string();
+}
+
+// Null table if linearization is disabled. Tables are cached per
+// configuration, so this is cheap unless the configuration is new.
+OSc_RichError *OpenScan::PrepareLinearization(
+    std::shared_ptr<const LinearizationTable> &table) {
+    table.reset();
+    std::size_t width = ScanWidth();
+    if (scanTurnaroundUs_ <= 0.0 || width < 2 || calibrating_)
+        return OSc_OK;
+
+    OSc_RichError *err;
+    OSc_Setting *acqSettings[3];
+    double pixelRateHz;
+    if (OSc_CHECK_ERROR(err, OSc_AcqTemplate_GetPixelRateSetting(
+                                 acqTemplate_, &acqSettings[0])) ||
+        OSc_CHECK_ERROR(err, OSc_AcqTemplate_GetResolutionSetting(
+                                 acqTemplate_, &acqSettings[1])) ||
+        OSc_CHECK_ERROR(err, OSc_AcqTemplate_GetZoomFactorSetting(
+                                 acqTemplate_, &acqSettings[2])) ||
+        OSc_CHECK_ERROR(err, OSc_Setting_GetFloat64Value(acqSettings[0],
+                                                         &pixelRateHz))) {
+        return err;
+    }
+    if (pixelRateHz <= 0.0)
+        return OSc_OK;
+
+    std::ostringstream key;
+    for (OSc_Setting *setting : acqSettings) {
+        std::string value;
+        if (OSc_CHECK_ERROR(err, FormatSettingValue(setting, value)))
+            return err;
+        key << value << ';';
+    }
+    key << width << ';' << scanTurnaroundUs_;
+
+    double lineUs = 1e6 * width / pixelRateHz;
+    table = linearizationTables_.Get(key.str(), width,
+                                     scanTurnaroundUs_ / lineUs);
+    return OSc_OK;
+}
+
+// Calibration references are kept per resolution, zoom and ROI
+OSc_RichError *OpenScan::CalibrationKey(std::string &key) {
+    OSc_RichError *err;
+    OSc_Setting *acqSettings[2];
+    if (OSc_CHECK_ERROR(err, OSc_AcqTemplate_GetResolutionSetting(
+                                 acqTemplate_, &acqSettings[0])) ||
+        OSc_CHECK_ERROR(err, OSc_AcqTemplate_GetZoomFactorSetting(
+                                 acqTemplate_, &acqSettings[1]))) {
+        return err;
+    }
+    std::ostringstream out;
+    for (OSc_Setting *setting : acqSettings) {
+        std::string value;
+        if (OSc_CHECK_ERROR(err, FormatSettingValue(setting, value)))
+            return err;
+        out << value << '-';
+    }
+
+    uint32_t x, y, width, height;
+    if (OSc_CHECK_ERROR(err, OSc_AcqTemplate_GetROI(acqTemplate_, &x, &y,
+                                                    &width, &height)))
+        return err;
+    out << x << '-' << y << '-' << width << 'x' << height;
+    key = out.str();
+    return OSc_OK;
+}
+
+// Empty if correction is disabled or there are no references
+OSc_RichError *
+OpenScan::PrepareFlatField(CalibrationStore::Correctors &correctors) {
+    correctors.clear();
+    if (!flatFieldEnabled_ || calibrating_)
+        return OSc_OK;
+    std::string key;
+    OSc_RichError *err = CalibrationKey(key);
+    if (err)
+        return err;
+    correctors = calibrationStore_.Get(key, GetNumberOfChannels(),
+                                       ScanWidth() * ScanHeight());
+    if (correctors.empty())
+        LogMessage("No dark/flat references for " + key +
+                   "; frames are not corrected");
+    return OSc_OK;
+}
+
+// Snaps the configured number of frames and saves their mean, per channel
+int OpenScan::RunCalibration(CalibrationKind kind) {
+    if (IsCapturing())
+        return DEVICE_CAMERA_BUSY_ACQUIRING;
+    if (calibrationStore_.GetDirectory().empty()) {
+        return AdHocErrorCode(std::string("Set ") +
+                              PROPERTY_CalibrationDirectory +
+                              " before calibrating");
+    }
+    std::size_t bytesPerPixel = SampleBytes();
+    if (bytesPerPixel > 2)
+        return AdHocErrorCode("Calibration needs 8- or 16-bit images");
+    std::string key;
+    OSc_RichError *err = CalibrationKey(key);
+    if (err)
+        return AdHocErrorCode(err);
+
+    std::size_t channels = GetNumberOfChannels();
+    // Snaps are neither corrected, binned nor converted while calibrating
+    std::size_t pixels = ScanWidth() * ScanHeight();
+    std::vector<std::vector<double>> sums(channels,
+                                          std::vector<double>(pixels, 0.0));
+    int errCode = DEVICE_OK;
+    calibrating_ = true;
+    for (long frame = 0; frame < calibrationFrames_; ++frame) {
+        errCode = SnapImage();
+        if (errCode != DEVICE_OK)
+            break;
+        for (std::size_t chan = 0; chan < channels; ++chan) {
+            const unsigned char *image = GetImageBuffer(unsigned(chan));
+            if (!image) {
+                errCode = AdHocErrorCode("Calibration frame missing");
+                break;
+            }
+            std::vector<double> &sum = sums[chan];
+            if (bytesPerPixel == 1) {
+                for (std::size_t i = 0; i < pixels; ++i)
+                    sum[i] += image[i];
+            } else {
+                const uint16_t *samples =
+                    reinterpret_cast<const uint16_t *>(image);
+                for (std::size_t i = 0; i < pixels; ++i)
+                    sum[i] += samples[i];
+            }
+        }
+        if (errCode != DEVICE_OK)
+            break;
+    }
+    calibrating_ = false;
+    if (errCode != DEVICE_OK)
+        return errCode;
+
+    for (std::size_t chan = 0; chan < channels; ++chan) {
+        std::vector<float> mean(pixels);
+        for (std::size_t i = 0; i < pixels; ++i)
+            mean[i] = float(sums[chan][i] / calibrationFrames_);
+        std::string path = calibrationStore_.Save(kind, key, chan, mean);
+        if (path.empty()) {
+            return AdHocErrorCode("Cannot write calibration reference to " +
+                                  calibrationStore_.GetDirectory());
+        }
+        LogMessage("Calibration: wrote " + path);
+    }
+    return DEVICE_OK;
+}
+
+// Called while arming, with no frames arriving
+OSc_RichError *OpenScan::ConfigurePipeline(FramePipeline &pipeline,
+                                           std::size_t channels) {
+    std::shared_ptr<const LinearizationTable> linearization;
+    CalibrationStore::Correctors flatField;
+    OSc_RichError *err = PrepareLinearization(linearization);
+    if (!err)
+        err = PrepareFlatField(flatField);
+    if (err)
+        return err;
+
+    FramePipeline::Config config;
+    config.channels = channels;
+    config.scanWidth = ScanWidth();
+    config.scanHeight = ScanHeight();
+    config.bytesPerPixel = SampleBytes();
+    config.sampleBits = SampleBits();
+    config.binning = calibrating_ ? 1 : ImageBinning();
+    config.output =
+        calibrating_ ? FramePipeline::OutputFormat_Native : outputFormat_;
+    config.accumulate = std::size_t(accumulateFrames_);
+    config.linePhase = !calibrating_;
+    config.linearization = linearization;
+    config.flatField = flatField;
+    pipeline.Configure(config);
+    return OSc_OK;
+}
+
+// Identifies the acquisition template state an acquisition is armed with,
+// and the number of frames snaps are armed for
+OSc_RichError *OpenScan::TemplateKey(std::string &key) {
+    OSc_RichError *err;
+    OSc_Setting *acqSettings[3];
+    if (OSc_CHECK_ERROR(err, OSc_AcqTemplate_GetPixelRateSetting(
+                                 acqTemplate_, &acqSettings[0])) ||
+        OSc_CHECK_ERROR(err, OSc_AcqTemplate_GetResolutionSetting(
+                                 acqTemplate_, &acqSettings[1])) ||
+        OSc_CHECK_ERROR(err, OSc_AcqTemplate_GetZoomFactorSetting(
+                                 acqTemplate_, &acqSettings[2]))) {
+        return err;
+    }
+    std::ostringstream out;
+    for (OSc_Setting *setting : acqSettings) {
+        std::string value;
+        if (OSc_CHECK_ERROR(err, FormatSettingValue(setting, value)))
+            return err;
+        out << value << ';';
+    }
+
+    uint32_t x, y, width, height;
+    if (OSc_CHECK_ERROR(err, OSc_AcqTemplate_GetROI(acqTemplate_, &x, &y,
+                                                    &width, &height)))
+        return err;
+    out << x << ',' << y << ',' << width << ',' << height << ';';
+
+    for (std::size_t i = 0; i < OSc_LSM_GetNumberOfDetectorDevices(oscLSM_);
+         ++i) {
+        out << (OSc_AcqTemplate_IsDetectorDeviceEnabled(acqTemplate_, i)
+                    ? '1'
+                    : '0');
+    }
+    out << ';' << SnapFrames();
+
+    key = out.str();
+    return OSc_OK;
+}
+
+void OpenScan::CompleteAcquisitionReport(bool stoppedByUser) {
+    AcquisitionReport &report = sequenceReport_;
+    report.stoppedByUser = stoppedByUser;
+    report.durationSeconds = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() -
+                                 sequenceStartTime_)
+                                 .count();
+
+    const SequenceCounts end = metrics_.GetSequenceCounts();
+    const SequenceCounts &start = sequenceStartCounts_;
+    report.framesDelivered = end.framesDelivered - start.framesDelivered;
+    report.imagesInserted = end.imagesInserted - start.imagesInserted;
+    report.imagesDroppedOnOverflow =
+        end.imagesDroppedOnOverflow - start.imagesDroppedOnOverflow;
+    report.imagesDroppedOther = end.imagesDropped - start.imagesDropped -
+                                report.imagesDroppedOnOverflow;
+    report.overflowEvents = end.overflowEvents - start.overflowEvents;
+
+    report.callbackLatency.clear();
+    for (const auto &hist : callbackLatency_) {
+        AcquisitionReport::ChannelLatency l;
+        l.count = hist->Count();
+        l.p50Us = hist->PercentileNs(50.0) / 1000.0;
+        l.p90Us = hist->PercentileNs(90.0) / 1000.0;
+        l.p99Us = hist->PercentileNs(99.0) / 1000.0;
+        l.p999Us = hist->PercentileNs(99.9) / 1000.0;
+        l.maxUs = hist->MaxNs() / 1000.0;
+        report.callbackLatency.push_back(l);
+    }
+
+    LogMessage(report.Summary());
+
+    if (reportDirectory_.empty())
+        return;
+    const std::string path = reportDirectory_ + "/acquisition-" +
+                             LocalTimeString("%Y%m%d-%H%M%S") + "-" +
+                             std::to_string(metrics_.sequencesStarted) +
+                             ".json";
+    FILE *fp = fopen(path.c_str(), "w");
+    if (!fp) {
+        LogMessage("Cannot write acquisition report: " + path);
+        return;
+    }
+    const std::string json = report.ToJson();
+    fwrite(json.data(), 1, json.size(), fp);
+    fclose(fp);
+}
+
+int OpenScan::GetMagnification(double *magnification) {
+    // We define magnification 1.0 as default resolution at Zoom 1.0.
+
+    OSc_RichError *err;
+    OSc_Setting *magSetting;
+    if (OSc_CHECK_ERROR(err, OSc_AcqTemplate_GetMagnificationSetting(
+                                 acqTemplate_, &magSetting))) {
+        return AdHocErrorCode(err);
+    }
+    return AdHocErrorCode(
+        OSc_Setting_GetFloat64Value(magSetting, magnification));
+}
+
+// A memory load or two; safe to poll from any thread
+bool OpenScan::Busy() {
+    if (busyOperations_.load(std::memory_order_acquire) > 0)
+        return true;
+    // Arming a sequence, or stopping the device after one
+    AcquisitionState state = sequenceState_.State();
+    return state == AcqState_Arming || state == AcqState_Stopping;
+}
+
+void OpenScan::GetName(char *name) const {
+    CDeviceUtils::CopyLimitedString(name, DEVICE_NAME_Camera);
+}
+
+namespace {
+
+// Records the duration of each phase of a snap into the metrics
+class SnapPhaseTimer {
+    AdapterMetrics &metrics_;
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::steady_clock::time_point phaseStart_;
+
+    static uint64_t ElapsedNs(std::chrono::steady_clock::time_point since) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - since)
+            .count();
+    }
+
+  public:
+    explicit SnapPhaseTimer(AdapterMetrics &metrics)
+        : metrics_(metrics), start_(std::chrono::steady_clock::now()),
+          phaseStart_(start_) {}
+
+    void EndPhase(SnapPhase phase) {
+        metrics_.lastSnapPhaseNs[phase] = ElapsedNs(phaseStart_);
+        phaseStart_ = std::chrono::steady_clock::now();
+    }
+
+    void EndSnap() {
+        metrics_.lastSnapPhaseNs[SnapPhase_Total] = ElapsedNs(start_);
+        ++metrics_.snaps;
+    }
+};
+
+// Marks the camera busy (see Busy()) for the duration of a scope
+class BusyScope {
+    std::atomic<int> &count_;
+
+  public:
+    explicit BusyScope(std::atomic<int> &count) : count_(count) { ++count_; }
+    ~BusyScope() { --count_; }
+    BusyScope(const BusyScope &) = delete;
+    BusyScope &operator=(const BusyScope &) = delete;
+};
+
+} // namespace
+
+extern "C" {
+static bool SnapFrameCallback(OSc_Acquisition *acq, uint32_t chan,
+                              void *pixels, void *data) {
+    OpenScan *self = static_cast<OpenScan *>(data);
+    OSCMM_TRACE_BEGIN("StoreSnapImage", chan);
+    self->StoreSnapImage(acq, chan, pixels);
+    OSCMM_TRACE_END("StoreSnapImage", chan);
+    return true;
+}
+}
+
+int OpenScan::SnapImage() {
+    if (IsCapturing()) {
+        if (snapDuringLive_ == SnapDuringLive_Busy)
+            return DEVICE_CAMERA_BUSY_ACQUIRING;
+        return SnapFromSequence();
+    }
+
+    BusyScope busy(busyOperations_);
+
+    // The device may still be stopping after a sequence
+    sequenceState_.WaitWhile(AcqState_Stopping);
+
+    DiscardPreviouslySnappedImages();
+
+    OSCMM_TRACE_INSTANT("SnapImage", 0);
+
+    SnapPhaseTimer timer(metrics_);
+
+    // Keep the arm thread from arming anything during the snap. The cache
+    // is only locked to take the acquisition (or make room for it), so that
+    // setting changes are not held up for the frame time or, with an
+    // external trigger, until the trigger arrives.
+    ++snapsInProgress_;
+    OSc_Acquisition *acq;
+    {
+        std::lock_guard<std::mutex> preArmLock(preArmMutex_);
+        acq = TakePreArmed(PreArm_Snap);
+        if (!acq)
+            preArmCache_.EvictTo(preArmCache_.Capacity() - 1);
+    }
+    OSc_RichError *err;
+    if (acq) {
+        timer.EndPhase(SnapPhase_Create);
+        timer.EndPhase(SnapPhase_Arm);
+    } else {
+        err = CreateSnapAcquisition(&acq);
+        if (err) {
+            --snapsInProgress_;
+            return AdHocErrorCode(err);
+        }
+        timer.EndPhase(SnapPhase_Create);
+
+        err = OSc_Acquisition_Arm(acq);
+        if (err)
+            goto error;
+        timer.EndPhase(SnapPhase_Arm);
+    }
+
+    err = ConfigurePipeline(snapPipeline_, GetNumberOfChannels());
+    if (err)
+        goto error;
+
+    snapStartTime_ = std::chrono::steady_clock::now();
+    err = OSc_Acquisition_Start(acq);
+    if (err)
+        goto error;
+    timer.EndPhase(SnapPhase_Start);
+
+    err = OSc_Acquisition_Wait(acq);
+    if (err)
+        goto error;
+    timer.EndPhase(SnapPhase_Wait);
+
+    OSc_Acquisition_Destroy(acq);
+    // Before re-arming, which is skipped while snaps are in progress
+    --snapsInProgress_;
+    if (WantsAnyPreArm())
+        PreArmInBackground();
+
+    timer.EndSnap();
+    return DEVICE_OK;
+
+error:
+    int errCode = AdHocErrorCode(err);
+    OSc_Acquisition_Destroy(acq);
+    --snapsInProgress_;
+    if (WantsAnyPreArm())
+        PreArmInBackground();
+    return errCode;
+}
+
+// Copies a complete frame set from the running sequence into the snap
+// buffers, waiting for one if needed
+int OpenScan::SnapFromSequence() {
+    BusyScope busy(busyOperations_);
+    DiscardPreviouslySnappedImages();
+    OSCMM_TRACE_INSTANT("SnapFromSequence", snapDuringLive_);
+
+    double framePeriod;
+    OSc_RichError *err = EstimateFramePeriod(framePeriod);
+    if (err)
+        return AdHocErrorCode(err);
+    auto timeout = std::chrono::milliseconds(MIN_STALL_TIMEOUT_MS) +
+                   std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::duration<double>(2.0 * framePeriod));
+
+    std::unique_lock<std::mutex> lock(liveFramesMutex_);
+    uint64_t seen = snapDuringLive_ == SnapDuringLive_LatestFrame
+                        ? 0
+                        : liveFramesCompleted_;
+    bool arrived = liveFramesCv_.wait_for(lock, timeout, [&] {
+        return !liveFramesOpen_ || liveFramesCompleted_ > seen;
+    });
+    // Arming, or finished meanwhile
+    if (!liveFramesOpen_)
+        return DEVICE_CAMERA_BUSY_ACQUIRING;
+    if (!arrived)
+        return AdHocErrorCode("Timed out waiting for a frame from the "
+                              "running sequence acquisition");
+
+    // The callback cannot publish another frame set while we hold the lock
+    std::size_t bytes = liveFrames_.ImageBytes();
+    snappedImages_.assign(liveFrames_.Channels(), 0);
+    for (std::size_t chan = 0; chan < liveFrames_.Channels(); ++chan) {
+        void *buffer = malloc(bytes);
+        memcpy(buffer, liveFrames_.Image(liveLatestSlot_, chan), bytes);
+        snappedImages_[chan] = buffer;
+        metrics_.bufferBytesInUse += bytes;
+    }
+    snappedImageBytes_ = bytes;
+    return DEVICE_OK;
+}
+
+// Called on the frame callback once all channels of a frame are stored
+void OpenScan::PublishLiveFrame() {
+    {
+        std::lock_guard<std::mutex> lock(liveFramesMutex_);
+        liveLatestSlot_ = 1 - liveLatestSlot_;
+        ++liveFramesCompleted_;
+    }
+    liveFramesCv_.notify_all();
+}
+
+// Created but not armed
+OSc_RichError *OpenScan::CreateSnapAcquisition(OSc_Acquisition **acq) {
+    OSc_RichError *err;
+    if (OSc_CHECK_ERROR(err, OSc_Acquisition_Create(acq, acqTemplate_)))
+        return err;
+    uint32_t count = SnapFrames();
+    if (OSc_CHECK_ERROR(err, OSc_Acquisition_SetData(*acq, this)) ||
+        OSc_CHECK_ERROR(err, OSc_Acquisition_SetNumberOfFrames(*acq, count)) ||
+        OSc_CHECK_ERROR(err, OSc_Acquisition_SetFrameCallback(
+                                 *acq, SnapFrameCallback))) {
+        OSc_Acquisition_Destroy(*acq);
+        *acq = 0;
+        return err;
+    }
+    return OSc_OK;
+}
+
+bool OpenScan::WantsPreArm(PreArmKind kind) const {
+    if (kind == PreArm_Snap && externalTrigger_)
+        return true;
+    return (preArmKinds_ & (1u << kind)) != 0;
+}
+
+bool OpenScan::WantsAnyPreArm() const {
+    return externalTrigger_ || preArmKinds_ != 0;
+}
+
+// Arms the wanted kinds of acquisition on the arm thread, for the current
+// template state, unless already armed. Devices that can only be armed for
+// one acquisition at a time (cache capacity 1) get the first wanted kind.
+void OpenScan::PreArmInBackground() {
+    armWorker_->Post([this] {
+        std::lock_guard<std::mutex> lock(preArmMutex_);
+        // A setting change or snap in progress re-arms when it is done
+        if (IsCapturing() || templateChanges_ > 0 || snapsInProgress_ > 0)
+            return;
+
+        std::string key;
+        OSc_RichError *err = TemplateKey(key);
+        std::size_t armed = 0;
+        for (PreArmKind kind : {PreArm_Snap, PreArm_Live}) {
+            if (err || armed == preArmCache_.Capacity())
+                break;
+            if (!WantsPreArm(kind) || preArmCache_.Contains(kind, key))
+                continue;
+            preArmCache_.EvictTo(preArmCache_.Capacity() - 1);
+
+            OSCMM_TRACE_BEGIN("PreArm", kind);
+            OSc_Acquisition *acq;
+            if (kind == PreArm_Snap) {
+                err = CreateSnapAcquisition(&acq);
+                if (!err && OSc_CHECK_ERROR(err, OSc_Acquisition_Arm(acq)))
+                    OSc_Acquisition_Destroy(acq);
+            } else {
+                err = CreateSequenceAcquisition(LONG_MAX, &acq);
+            }
+            OSCMM_TRACE_END("PreArm", err == OSc_OK);
+            if (!err) {
+                preArmCache_.Put(kind, key, acq);
+                ++armed;
+            }
+        }
+        if (err) {
+            ++metrics_.errors;
+            LogMessage("Cannot pre-arm acquisition: " + FormatRichError(err));
+        }
+    });
+}
+
+OSc_Acquisition *OpenScan::TakePreArmed(PreArmKind kind) {
+    bool wanted = WantsPreArm(kind);
+    if (!wanted && preArmCache_.Size() == 0)
+        return 0;
+
+    std::string key;
+    OSc_RichError *err = TemplateKey(key);
+    if (err) {
+        LogMessage("Cannot use pre-armed acquisition: " +
+                   FormatRichError(err));
+        return 0;
+    }
+    OSc_Acquisition *acq = preArmCache_.Take(kind, key);
+    if (wanted) {
+        if (acq)
+            ++metrics_.preArmHits;
+        else
+            ++metrics_.preArmMisses;
+    }
+    return acq;
+}
+
+// Waits for pre-arming in progress, if any
+void OpenScan::DiscardPreArmed(bool all) {
+    std::lock_guard<std::mutex> lock(preArmMutex_);
+    if (all)
+        preArmCache_.Clear();
+    else
+        preArmCache_.EvictTo(preArmCache_.Capacity() - 1);
+}
+
+OpenScan::TemplateChange::TemplateChange(OpenScan *self) : self_(self) {
+    // The teardown thread may still be stopping and destroying the last
+    // sequence acquisition, which settings must not change under
+    self_->sequenceState_.WaitWhile(AcqState_Stopping);
+    ++self_->busyOperations_;
+    ++self_->templateChanges_;
+    // Armed devices may not accept setting changes
+    self_->DiscardPreArmed(false);
+}
+
+OpenScan::TemplateChange::~TemplateChange() {
+    --self_->templateChanges_;
+    --self_->busyOperations_;
+    // Further changes in quick succession postpone arming
+    if (self_->WantsAnyPreArm())
+        self_->preArmDebouncer_->Trigger();
+}
+
+void OpenScan::StoreSnapImage(OSc_Acquisition *, uint32_t chan, void *pixels) {
+    if (chan == 0) {
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - snapStartTime_)
+                          .count();
+        snapStartToFrame_.Record(ns);
+        metrics_.lastSnapStartToFrameNs = ns;
+    }
+
+    // Raw, unbinned frames while calibrating
+    void *frame = snapPipeline_.Process(chan, pixels);
+    size_t bufSize = snapPipeline_.OutputBytes();
+    if (snappedImages_.size() < chan + 1)
+        snappedImages_.resize(chan + 1, 0);
+    // Accumulating snaps deliver several frames; the last one is kept
+    if (snappedImages_[chan] && snappedImageBytes_ == bufSize) {
+        memcpy(snappedImages_[chan], frame, bufSize);
+        return;
+    }
+
+    void *buffer = malloc(bufSize);
+    memcpy(buffer, frame, bufSize);
+    if (snappedImages_[chan]) {
+        free(snappedImages_[chan]);
+        metrics_.bufferBytesInUse -= snappedImageBytes_;
+    }
+    snappedImages_[chan] = buffer;
+    snappedImageBytes_ = bufSize;
+    metrics_.bufferBytesInUse += bufSize;
+}
+
+void OpenScan::DiscardPreviouslySnappedImages() {
+    for (std::vector<void *>::iterator it = snappedImages_.begin(),
+                                       end = snappedImages_.end();
+         it != end; ++it) {
+        if (*it) {
+            free(*it);
+            metrics_.bufferBytesInUse -= snappedImageBytes_;
+        }
+    }
+    snappedImages_.clear();
+}
+
+const unsigned char *OpenScan::GetImageBuffer(unsigned chan) {
+    if (chan >= GetNumberOfChannels() || chan >= snappedImages_.size())
+        return 0;
+    return reinterpret_cast<unsigned char *>(snappedImages_[chan]);
+}
+
+long OpenScan::GetImageBufferSize() const {
+    return GetImageWidth() * GetImageHeight() * GetImageBytesPerPixel();
+}
+
+unsigned OpenScan::GetImageWidth() const {
+    return ScanWidth() / ImageBinning();
+}
+
+unsigned OpenScan::GetImageHeight() const {
+    return ScanHeight() / ImageBinning();
+}
+
+// The pipeline only bins 8- and 16-bit samples
+unsigned OpenScan::ImageBinning() const {
+    return SampleBytes() <= 2 ? unsigned(binning_) : 1;
+}
+
+// Size of the scanned frame, before binning
+unsigned OpenScan::ScanWidth() const {
+    uint32_t xOffset, yOffset, width, height;
+    OSc_AcqTemplate_GetROI(acqTemplate_, &xOffset, &yOffset, &width, &height);
+    return width;
+}
+
+unsigned OpenScan::ScanHeight() const {
+    uint32_t xOffset, yOffset, width, height;
+    OSc_AcqTemplate_GetROI(acqTemplate_, &xOffset, &yOffset, &width, &height);
+    return height;
+}
+
+// Of delivered images
+unsigned OpenScan::GetImageBytesPerPixel() const {
+    unsigned bytes = SampleBytes();
+    if (bytes > 2)
+        return bytes; // Not processed
+    switch (outputFormat_) {
+    case FramePipeline::OutputFormat_8Bit:
+        return 1;
+    case FramePipeline::OutputFormat_32BitMean:
+        return 4;
+    default:
+        return bytes;
+    }
+}
+
+// Accumulated frames per snap; calibration uses single raw frames
+uint32_t OpenScan::SnapFrames() const {
+    bool wide = GetImageBytesPerPixel() == 4 && SampleBytes() <= 2;
+    return wide && !calibrating_ ? uint32_t(accumulateFrames_) : 1;
+}
+
+// Of acquired samples
+unsigned OpenScan::SampleBytes() const {
+    uint32_t bps;
+    OSc_AcqTemplate_GetBytesPerSample(acqTemplate_, &bps);
+    return bps;
+}
+
+// OpenScanLib only reports whole bytes per sample
+unsigned OpenScan::SampleBits() const {
+    unsigned bits = 8 * SampleBytes();
+    if (detectorBitDepth_ > 0 && unsigned(detectorBitDepth_) < bits)
+        return unsigned(detectorBitDepth_);
+    return bits;
+}
+
+unsigned OpenScan::GetNumberOfComponents() const { return 1; }
+
+unsigned OpenScan::GetNumberOfChannels() const {
+    uint32_t nChannels;
+    OSc_AcqTemplate_GetNumberOfChannels(acqTemplate_, &nChannels);
+    return nChannels;
 }
 
 int OpenScan::GetChannelName(unsigned channel, char *name) {
@@ -656,241 +2242,1430 @@ int OpenScan::GetChannelName(unsigned channel, char *name) {
     return DEVICE_OK;
 }
 
-unsigned OpenScan::GetBitDepth() const {
-    // TODO Get from OpenScan
-    return 16;
+// Means keep the sample range
+unsigned OpenScan::GetBitDepth() const {
+    unsigned bytes = GetImageBytesPerPixel();
+    if (bytes < SampleBytes())
+        return 8 * bytes;
+    return SampleBits();
+}
+
+int OpenScan::SetBinning(int binSize) {
+    return SetProperty(MM::g_Keyword_Binning,
+                       std::to_string(binSize).c_str());
+}
+
+// ROI coordinates are in (binned) image pixels
+int OpenScan::SetROI(unsigned x, unsigned y, unsigned width, unsigned height) {
+    TemplateChange change(this);
+    unsigned binning = ImageBinning();
+    return AdHocErrorCode(OSc_AcqTemplate_SetROI(
+        acqTemplate_, x * binning, y * binning, width * binning,
+        height * binning));
+}
+
+int OpenScan::GetROI(unsigned &x, unsigned &y, unsigned &xSize,
+                     unsigned &ySize) {
+    int errCode = AdHocErrorCode(
+        OSc_AcqTemplate_GetROI(acqTemplate_, &x, &y, &xSize, &ySize));
+    unsigned binning = ImageBinning();
+    x /= binning;
+    y /= binning;
+    xSize /= binning;
+    ySize /= binning;
+    return errCode;
+}
+
+int OpenScan::ClearROI() {
+    TemplateChange change(this);
+    OSc_AcqTemplate_ResetROI(acqTemplate_);
+    return DEVICE_OK;
+}
+
+extern "C" {
+static bool SequenceFrameCallback(OSc_Acquisition *acq, uint32_t chan,
+                                  void *pixels, void *data) {
+    OpenScan *self = static_cast<OpenScan *>(data);
+    OSCMM_TRACE_BEGIN("SequenceFrameCallback", chan);
+    bool ret = self->SendSequenceImage(acq, chan, pixels);
+    OSCMM_TRACE_END("SequenceFrameCallback", chan);
+    return ret;
+}
+}
+
+int OpenScan::StartSequenceAcquisition(long count, double,
+                                       bool stopOnOverflow) {
+    if (IsCapturing())
+        return DEVICE_CAMERA_BUSY_ACQUIRING;
+
+    if (count < 1)
+        return DEVICE_OK;
+
+    {
+        // While the previous sequence is being torn down, queue the start;
+        // FinishSequenceAcquisition() checks for it under the same lock
+        std::lock_guard<std::mutex> lock(queuedStartMutex_);
+        if (sequenceState_.State() == AcqState_Stopping) {
+            queuedStartCount_ = count;
+            queuedStartStopOnOverflow_ = stopOnOverflow;
+            startQueued_ = true;
+            OSCMM_TRACE_INSTANT("QueueSequenceStart", count);
+            return DEVICE_OK;
+        }
+    }
+
+    if (!sequenceState_.BeginArming())
+        return DEVICE_CAMERA_BUSY_ACQUIRING;
+    std::string error = ArmAndStartSequence(count, stopOnOverflow);
+    if (!error.empty())
+        return AdHocErrorCode(error);
+    return DEVICE_OK;
+}
+
+// Called in the Arming state. Returns an error message, empty on success;
+// also runs on the teardown thread, so it makes no ad-hoc error codes.
+std::string OpenScan::ArmAndStartSequence(long count, bool stopOnOverflow) {
+    OSCMM_TRACE_INSTANT("StartSequenceAcquisition", count);
+
+    for (auto &hist : callbackLatency_)
+        hist->Reset();
+
+    sequenceReport_ = AcquisitionReport();
+    std::string error = CaptureAcquisitionConfig(sequenceReport_);
+    if (!error.empty()) {
+        sequenceState_.Transition(AcqState_Arming, AcqState_Failed);
+        return error;
+    }
+    sequenceReport_.requestedFrames = count;
+    sequenceReport_.stopOnOverflow = stopOnOverflow;
+    sequenceStartCounts_ = metrics_.GetSequenceCounts();
+    sequenceFramesReceived_ = 0;
+    lastFrameTime_ = std::chrono::steady_clock::time_point();
+    sequenceAcquisitionStopOnOverflow_ = stopOnOverflow;
+    sequenceGeometry_.width = GetImageWidth();
+    sequenceGeometry_.height = GetImageHeight();
+    sequenceGeometry_.bytesPerPixel = GetImageBytesPerPixel();
+    // Also resets filter state, which may not match a changed geometry
+    OSc_RichError *pipelineErr =
+        ConfigurePipeline(framePipeline_, sequenceReport_.numChannels);
+    if (pipelineErr) {
+        sequenceState_.Transition(AcqState_Arming, AcqState_Failed);
+        return FormatRichError(pipelineErr);
+    }
+
+    if (burstMode_ && count != LONG_MAX)
+        error = AllocateBurstBuffer(count);
+    else if (preTriggerSeconds_ > 0.0 && count == LONG_MAX)
+        error = AllocateRingBuffer();
+    teardownDelivers_ = !burstBuffer_.Empty() || !ringBuffer_.Empty();
+    if (error.empty() && snapDuringLive_ != SnapDuringLive_Busy) {
+        if (liveFrames_.Allocate(2, sequenceReport_.numChannels,
+                                 sequenceGeometry_.Bytes(), false)) {
+            metrics_.bufferBytesInUse += liveFrames_.Bytes();
+            std::lock_guard<std::mutex> lock(liveFramesMutex_);
+            liveFramesOpen_ = true;
+            liveFramesCompleted_ = 0;
+            liveLatestSlot_ = 0;
+        } else {
+            ReleaseSequenceBuffers();
+            error = "Cannot allocate memory for snaps during live";
+        }
+    }
+    if (!error.empty()) {
+        sequenceState_.Transition(AcqState_Arming, AcqState_Failed);
+        return error;
+    }
+
+    OSc_Acquisition *acq;
+    {
+        std::lock_guard<std::mutex> lock(preArmMutex_);
+        acq = count == LONG_MAX ? TakePreArmed(PreArm_Live) : 0;
+        if (!acq)
+            preArmCache_.EvictTo(preArmCache_.Capacity() - 1);
+    }
+    OSc_RichError *err = OSc_OK;
+    if (!acq)
+        err = CreateSequenceAcquisition(count, &acq);
+    if (err) {
+        ReleaseSequenceBuffers();
+        sequenceState_.Transition(AcqState_Arming, AcqState_Failed);
+        return FormatRichError(err);
+    }
+    GetCoreCallback()->PrepareForAcq(this);
+
+    metrics_.sequenceRunning = true;
+    sequenceStartTime_ = std::chrono::steady_clock::now();
+    bool stillArming;
+    err = StartArmedAcquisition(acq, stillArming);
+    if (err) {
+        metrics_.sequenceRunning = false;
+        if (stillArming) {
+            // Otherwise the teardown of the stop request releases them
+            ReleaseSequenceBuffers();
+            sequenceState_.Transition(AcqState_Arming, AcqState_Failed);
+        }
+        return FormatRichError(err);
+    }
+    ++metrics_.sequencesStarted;
+
+    std::chrono::milliseconds timeout = StallTimeout();
+    if (timeout.count() > 0)
+        stallWatchdog_->Arm(timeout);
+
+    return std::string();
+}
+
+// Created acquisitions are armed; on error nothing is left to clean up
+OSc_RichError *OpenScan::CreateSequenceAcquisition(long count,
+                                                   OSc_Acquisition **acq) {
+    OSc_RichError *err;
+    if (OSc_CHECK_ERROR(err, OSc_Acquisition_Create(acq, acqTemplate_)))
+        return err;
+    if (OSc_CHECK_ERROR(err, OSc_Acquisition_SetData(*acq, this)) ||
+        OSc_CHECK_ERROR(err, OSc_Acquisition_SetNumberOfFrames(*acq, count)) ||
+        OSc_CHECK_ERROR(err, OSc_Acquisition_SetFrameCallback(
+                                 *acq, SequenceFrameCallback)) ||
+        OSc_CHECK_ERROR(err, OSc_Acquisition_Arm(*acq))) {
+        OSc_Acquisition_Destroy(*acq);
+        *acq = 0;
+        return err;
+    }
+    return OSc_OK;
+}
+
+// Called in the Arming state. The state becomes Running before the start, so
+// that frame callbacks (which may arrive before OSc_Acquisition_Start
+// returns) see it. On error the acquisition is destroyed and, unless a stop
+// request took over meanwhile, the state returns to Arming.
+OSc_RichError *OpenScan::StartArmedAcquisition(OSc_Acquisition *acq,
+                                               bool &stillArming) {
+    sequenceState_.SetAcquisition(acq);
+    sequenceState_.Transition(AcqState_Arming, AcqState_Running);
+    OSc_RichError *err = OSc_Acquisition_Start(acq);
+    stillArming = false;
+    if (err &&
+        sequenceState_.Transition(AcqState_Running, AcqState_Arming)) {
+        OSc_Acquisition_Destroy(sequenceState_.TakeAcquisition());
+        stillArming = true;
+    }
+    return err;
+}
+
+std::string OpenScan::AllocateBurstBuffer(long count) {
+    std::size_t imageBytes = sequenceGeometry_.Bytes();
+    std::size_t channels = sequenceReport_.numChannels;
+    double megabytes = double(count) * channels * imageBytes / (1 << 20);
+    if (megabytes > burstMaxMemoryMB_) {
+        std::ostringstream msg;
+        msg << "Burst of " << count << " frames needs " << megabytes
+            << " MB, more than " << PROPERTY_BurstMaxMemoryMB;
+        return msg.str();
+    }
+
+    OSCMM_TRACE_BEGIN("AllocateBurst", count);
+    bool allocated =
+        burstBuffer_.Allocate(count, channels, imageBytes, burstPrefault_);
+    OSCMM_TRACE_END("AllocateBurst", allocated);
+    if (!allocated) {
+        return "Cannot allocate memory for burst of " +
+               std::to_string(count) + " frames";
+    }
+    metrics_.bufferBytesInUse += burstBuffer_.Bytes();
+    return std::string();
+}
+
+// Runs on the teardown thread, once no more frames can arrive. Stops at the
+// first image the core does not accept.
+void OpenScan::DrainBurstBuffer() {
+    uint64_t frames = std::min<uint64_t>(sequenceFramesReceived_,
+                                         burstBuffer_.Slots());
+    auto start = std::chrono::steady_clock::now();
+    OSCMM_TRACE_BEGIN("DrainBurst", frames);
+    uint64_t inserted = 0;
+    bool ok = true;
+    for (uint64_t frame = 0; ok && frame < frames; ++frame) {
+        for (uint32_t chan = 0; ok && chan < burstBuffer_.Channels(); ++chan)
+            ok = InsertSequenceImage(chan, burstBuffer_.Image(frame, chan));
+        if (ok)
+            ++inserted;
+    }
+    OSCMM_TRACE_END("DrainBurst", inserted);
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    std::ostringstream msg;
+    msg << "Burst: inserted " << inserted << '/' << frames << " frames in "
+        << ms << " ms";
+    LogMessage(msg.str());
+}
+
+// The ring is sized from the frame period estimated without line or frame
+// overhead, so it holds at least the requested duration
+std::string OpenScan::AllocateRingBuffer() {
+    double period;
+    OSc_RichError *err = EstimateFramePeriod(period);
+    if (err)
+        return FormatRichError(err);
+    if (period <= 0.0)
+        return "Cannot size the pre-trigger ring: unknown frame rate";
+    ringPreFrames_ = static_cast<uint64_t>(std::ceil(preTriggerSeconds_ /
+                                                     period));
+    ringPostFrames_ = static_cast<uint64_t>(std::ceil(postTriggerSeconds_ /
+                                                      period));
+
+    // The post-trigger frames are written after the pre-trigger frames, so
+    // the ring needs room for both
+    uint64_t slots = ringPreFrames_ + ringPostFrames_;
+    std::size_t imageBytes = sequenceGeometry_.Bytes();
+    std::size_t channels = sequenceReport_.numChannels;
+    double megabytes = double(slots) * channels * imageBytes / (1 << 20);
+    if (megabytes > preTriggerMaxMemoryMB_) {
+        std::ostringstream msg;
+        msg << "Pre-trigger ring of " << slots << " frames needs "
+            << megabytes << " MB, more than "
+            << PROPERTY_PreTriggerMaxMemoryMB;
+        return msg.str();
+    }
+
+    // Every page is overwritten continuously, so always pre-fault
+    OSCMM_TRACE_BEGIN("AllocateRing", slots);
+    bool allocated = ringBuffer_.Allocate(slots, channels, imageBytes, true);
+    OSCMM_TRACE_END("AllocateRing", allocated);
+    if (!allocated) {
+        return "Cannot allocate memory for pre-trigger ring of " +
+               std::to_string(slots) + " frames";
+    }
+    metrics_.bufferBytesInUse += ringBuffer_.Bytes();
+
+    ringStartFrame_ = 0;
+    ringFrozen_ = false;
+    capturePending_ = false;
+    previewFrame_ = false;
+    lastPreviewTime_ = std::chrono::steady_clock::time_point();
+    captureRequested_ = false;
+    ringResumeRequested_ = false;
+    ringActive_ = true;
+    return std::string();
+}
+
+// Called on the frame callback for each channel
+bool OpenScan::StoreRingImage(uint32_t chan, void *pixels) {
+    if (!ringFrozen_) {
+        ringBuffer_.Store(sequenceFramesReceived_ % ringBuffer_.Slots(), chan,
+                          pixels);
+    }
+
+    if (chan == 0) {
+        auto now = std::chrono::steady_clock::now();
+        previewFrame_ = now - lastPreviewTime_ >= PRE_TRIGGER_PREVIEW_INTERVAL;
+        if (previewFrame_)
+            lastPreviewTime_ = now;
+    }
+    // Preview images the core cannot take are simply skipped
+    if (previewFrame_)
+        InsertSequenceImage(chan, pixels);
+    return true;
+}
+
+// Called on the frame callback once all channels of a frame are stored
+void OpenScan::AdvanceRing(uint64_t framesReceived) {
+    if (ringFrozen_) {
+        if (ringResumeRequested_.exchange(false)) {
+            ringFrozen_ = false;
+            ringStartFrame_ = framesReceived;
+        }
+        return;
+    }
+
+    if (captureRequested_.exchange(false)) {
+        capturePending_ = true;
+        captureStartFrame_ =
+            framesReceived -
+            std::min(ringPreFrames_, framesReceived - ringStartFrame_);
+        captureEndFrame_ = framesReceived + ringPostFrames_;
+        OSCMM_TRACE_INSTANT("CaptureTriggered", framesReceived);
+    }
+    if (capturePending_ && framesReceived >= captureEndFrame_) {
+        // Stop overwriting the captured frames until they are written out;
+        // the teardown thread also keeps the ring alive meanwhile
+        capturePending_ = false;
+        ringFrozen_ = true;
+        uint64_t start = captureStartFrame_;
+        uint64_t end = captureEndFrame_;
+        teardownWorker_->Post([this, start, end] {
+            WriteCapture(start, end);
+            captureInProgress_ = false;
+            ringResumeRequested_ = true;
+        });
+    }
+}
+
+// Runs on the teardown thread while the frames are not being overwritten
+void OpenScan::WriteCapture(uint64_t startFrame, uint64_t endFrame) {
+    CaptureTag tag;
+    tag.capture = ++captureCount_;
+    tag.frames = endFrame - startFrame;
+    std::string path;
+    FILE *fp = 0;
+    if (!captureDirectory_.empty()) {
+        path = captureDirectory_ + "/capture-" +
+               LocalTimeString("%Y%m%d-%H%M%S") + "-" +
+               std::to_string(tag.capture) + ".raw";
+        fp = fopen(path.c_str(), "wb");
+        if (!fp) {
+            ++metrics_.errors;
+            LogMessage("Cannot write capture: " + path);
+            return;
+        }
+    }
+
+    OSCMM_TRACE_BEGIN("WriteCapture", endFrame - startFrame);
+    uint64_t written = 0;
+    bool ok = true;
+    for (uint64_t frame = startFrame; ok && frame < endFrame; ++frame) {
+        std::size_t slot = frame % ringBuffer_.Slots();
+        tag.frame = frame - startFrame;
+        for (uint32_t chan = 0; ok && chan < ringBuffer_.Channels(); ++chan) {
+            unsigned char *image = ringBuffer_.Image(slot, chan);
+            if (fp)
+                ok = fwrite(image, ringBuffer_.ImageBytes(), 1, fp) == 1;
+            else
+                ok = InsertSequenceImage(chan, image, &tag);
+        }
+        if (ok)
+            ++written;
+    }
+    OSCMM_TRACE_END("WriteCapture", written);
+
+    // Raw files hold the frames in order, each frame's channels in turn
+    std::ostringstream msg;
+    msg << "Capture: wrote " << written << '/' << endFrame - startFrame
+        << " frames of " << ringBuffer_.Channels() << " x "
+        << sequenceGeometry_.width << " x " << sequenceGeometry_.height
+        << " x " << sequenceGeometry_.bytesPerPixel << " bytes";
+    if (fp) {
+        if (fclose(fp) != 0)
+            ok = false;
+        msg << " to " << path;
+    }
+    if (!ok)
+        ++metrics_.errors;
+    LogMessage(msg.str());
+}
+
+// Runs on the teardown thread, once no more frames can arrive. A capture
+// still waiting for post-trigger frames is written out with what arrived.
+void OpenScan::FinishRing() {
+    if (capturePending_)
+        WriteCapture(captureStartFrame_, sequenceFramesReceived_);
+    capturePending_ = false;
+}
+
+void OpenScan::ReleaseSequenceBuffers() {
+    ringActive_ = false;
+    captureRequested_ = false;
+    captureInProgress_ = false;
+    metrics_.bufferBytesInUse -= burstBuffer_.Bytes() + ringBuffer_.Bytes();
+    burstBuffer_.Release();
+    ringBuffer_.Release();
+
+    {
+        // Waits for a snap copying from the buffer
+        std::lock_guard<std::mutex> lock(liveFramesMutex_);
+        liveFramesOpen_ = false;
+        metrics_.bufferBytesInUse -= liveFrames_.Bytes();
+        liveFrames_.Release();
+    }
+    liveFramesCv_.notify_all();
+}
+
+// Pixel time only (no line or frame overhead); zero if the pixel rate is not
+// positive
+OSc_RichError *OpenScan::EstimateFramePeriod(double &seconds) {
+    seconds = 0.0;
+    OSc_RichError *err;
+    OSc_Setting *pixelRateSetting;
+    double pixelRateHz;
+    if (OSc_CHECK_ERROR(err, OSc_AcqTemplate_GetPixelRateSetting(
+                                 acqTemplate_, &pixelRateSetting)) ||
+        OSc_CHECK_ERROR(err, OSc_Setting_GetFloat64Value(pixelRateSetting,
+                                                         &pixelRateHz))) {
+        return err;
+    }
+    if (pixelRateHz > 0.0)
+        seconds = double(ScanWidth()) * ScanHeight() / pixelRateHz;
+    return OSc_OK;
+}
+
+// Zero if the watchdog is disabled or the frame period cannot be estimated
+std::chrono::milliseconds OpenScan::StallTimeout() {
+    if (stallTimeoutFactor_ <= 0.0)
+        return std::chrono::milliseconds(0);
+
+    double framePeriod;
+    OSc_RichError *err = EstimateFramePeriod(framePeriod);
+    if (err) {
+        LogMessage("Stall watchdog disabled: " + FormatRichError(err));
+        return std::chrono::milliseconds(0);
+    }
+    if (framePeriod <= 0.0)
+        return std::chrono::milliseconds(0);
+
+    double framePeriodMs = 1000.0 * framePeriod;
+    long timeoutMs = static_cast<long>(framePeriodMs * stallTimeoutFactor_);
+    return std::chrono::milliseconds(
+        std::max(timeoutMs, MIN_STALL_TIMEOUT_MS));
+}
+
+// Called on the watchdog thread
+void OpenScan::RecoverStalledAcquisition(
+    std::chrono::milliseconds stalledFor) {
+    if (sequenceState_.State() != AcqState_Running)
+        return;
+
+    OSCMM_TRACE_INSTANT("AcquisitionStall", stalledFor.count());
+    ++metrics_.acquisitionStalls;
+    LogMessage("Sequence acquisition stalled: no frame for " +
+               std::to_string(stalledFor.count()) + " ms");
+
+    // The acquisition may have ended without delivering all frames, for
+    // example after a device error
+    bool isRunning = true;
+    OSc_RichError *err = OSc_LSM_IsRunningAcquisition(oscLSM_, &isRunning);
+    if (err)
+        OSc_Error_Destroy(err);
+    if (!stallRecovery_ && isRunning)
+        return;
+
+    if (!sequenceState_.Transition(AcqState_Running, AcqState_Arming))
+        return; // Stopped or finished meanwhile
+    OSc_Acquisition *stalled = sequenceState_.TakeAcquisition();
+    OSc_Acquisition_Stop(stalled);
+    OSc_Acquisition_Destroy(stalled);
+
+    long count = sequenceReport_.requestedFrames;
+    if (count != LONG_MAX)
+        count -= static_cast<long>(sequenceFramesReceived_);
+    if (!stallRecovery_ || count < 1) {
+        if (!stallRecovery_)
+            LogMessage("Sequence acquisition ended before all frames were "
+                       "received");
+        sequenceState_.Transition(AcqState_Arming, AcqState_Stopping);
+        BeginTeardown(0, false,
+                      stallRecovery_ ? AcqState_Finished : AcqState_Failed);
+        return;
+    }
+
+    OSc_Acquisition *acq;
+    err = CreateSequenceAcquisition(count, &acq);
+    bool stillArming = true;
+    if (!err)
+        err = StartArmedAcquisition(acq, stillArming);
+    if (err) {
+        ++metrics_.errors;
+        LogMessage("Cannot restart stalled sequence acquisition: " +
+                   FormatRichError(err));
+        if (stillArming) {
+            sequenceState_.Transition(AcqState_Arming, AcqState_Stopping);
+            BeginTeardown(0, false, AcqState_Failed);
+        }
+        return;
+    }
+
+    ++metrics_.acquisitionRecoveries;
+    LogMessage("Sequence acquisition restarted after stall");
+}
+
+// Returns without waiting for the device to stop; AcqFinished is signaled
+// when the teardown completes
+int OpenScan::StopSequenceAcquisition() {
+    {
+        // Stopping also cancels a start queued behind a teardown
+        std::lock_guard<std::mutex> lock(queuedStartMutex_);
+        startQueued_ = false;
+    }
+
+    // Stall recovery (or a queued start) may be arming an acquisition
+    if (sequenceState_.WaitWhile(AcqState_Arming) != AcqState_Running ||
+        !sequenceState_.Transition(AcqState_Running, AcqState_Stopping))
+        return DEVICE_OK;
+
+    OSCMM_TRACE_INSTANT("StopSequenceAcquisition", 0);
+    BeginTeardown(sequenceState_.TakeAcquisition(), true, AcqState_Finished);
+    return DEVICE_OK;
+}
+
+// Called in the Stopping state; hands the acquisition to the teardown thread
+void OpenScan::BeginTeardown(OSc_Acquisition *acq, bool stoppedByUser,
+                             AcquisitionState endState) {
+    stallWatchdog_->Disarm();
+    teardownWorker_->Post([this, acq, stoppedByUser, endState] {
+        if (acq) {
+            OSCMM_TRACE_BEGIN("TeardownSequence", stoppedByUser);
+            // Stopping waits for the device to finish the current frame
+            if (stoppedByUser)
+                OSc_Acquisition_Stop(acq);
+            else
+                OSc_Acquisition_Wait(acq);
+            OSc_Acquisition_Destroy(acq);
+            OSCMM_TRACE_END("TeardownSequence", stoppedByUser);
+        }
+        FinishSequenceAcquisition(stoppedByUser, endState);
+    });
+}
+
+// Runs on the teardown thread
+void OpenScan::FinishSequenceAcquisition(bool stoppedByUser,
+                                         AcquisitionState endState) {
+    if (!burstBuffer_.Empty())
+        DrainBurstBuffer();
+    if (!ringBuffer_.Empty())
+        FinishRing();
+    ReleaseSequenceBuffers();
+    GetCoreCallback()->AcqFinished(this, DEVICE_OK);
+    teardownDelivers_ = false;
+    metrics_.sequenceRunning = false;
+
+    CompleteAcquisitionReport(stoppedByUser);
+
+    long count = 0;
+    bool stopOnOverflow = false;
+    {
+        std::lock_guard<std::mutex> lock(queuedStartMutex_);
+        if (startQueued_) {
+            count = queuedStartCount_;
+            stopOnOverflow = queuedStartStopOnOverflow_;
+            // Go directly to Arming, so that IsCapturing() stays true
+            sequenceState_.Transition(AcqState_Stopping, AcqState_Arming);
+            startQueued_ = false;
+        } else {
+            sequenceState_.Transition(AcqState_Stopping, endState);
+        }
+    }
+    if (count == 0 && WantsAnyPreArm())
+        PreArmInBackground();
+
+    if (count > 0) {
+        // Not on the GUI thread, so no ad-hoc error code
+        std::string error = ArmAndStartSequence(count, stopOnOverflow);
+        if (!error.empty()) {
+            ++metrics_.errors;
+            LogMessage("Queued sequence acquisition failed to start: " +
+                       error);
+        }
+    }
+}
+
+bool OpenScan::SendSequenceImage(OSc_Acquisition *, uint32_t chan,
+                                 void *pixels) {
+    // Discard frames that arrive after a stop request
+    if (sequenceState_.State() != AcqState_Running)
+        return false;
+
+    auto received = std::chrono::steady_clock::now();
+    stallWatchdog_->Progress();
+    OSCMM_TRACE_BEGIN("ProcessFrame", chan);
+    pixels = framePipeline_.Process(chan, pixels);
+    OSCMM_TRACE_END("ProcessFrame", chan);
+    if (chan == 0) {
+        if (lastFrameTime_.time_since_epoch().count() != 0) {
+            sequenceReport_.frameIntervalMs.Add(
+                std::chrono::duration<double, std::milli>(received -
+                                                          lastFrameTime_)
+                    .count());
+        }
+        lastFrameTime_ = received;
+    }
+    OSCMM_TRACE_BEGIN("SendSequenceImage", chan);
+    // Snaps only read the other slot
+    if (!liveFrames_.Empty())
+        liveFrames_.Store(1 - liveLatestSlot_, chan, pixels);
+    bool ret;
+    if (!burstBuffer_.Empty()) {
+        // Complete frame sets received so far index the slot
+        uint64_t slot = sequenceFramesReceived_;
+        ret = slot < burstBuffer_.Slots();
+        if (ret)
+            burstBuffer_.Store(slot, chan, pixels);
+    } else if (!ringBuffer_.Empty()) {
+        ret = StoreRingImage(chan, pixels);
+    } else {
+        ret = InsertSequenceImage(chan, pixels);
+    }
+    OSCMM_TRACE_END("SendSequenceImage", chan);
+    if (chan < callbackLatency_.size()) {
+        callbackLatency_[chan]->Record(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - received)
+                .count());
+    }
+
+    bool lastFrame = false;
+    if (chan + 1 == sequenceReport_.numChannels) {
+        uint64_t frames = ++sequenceFramesReceived_;
+        lastFrame = sequenceReport_.requestedFrames != LONG_MAX &&
+                    frames >= uint64_t(sequenceReport_.requestedFrames);
+        if (!ringBuffer_.Empty())
+            AdvanceRing(frames);
+        if (!liveFrames_.Empty())
+            PublishLiveFrame();
+    }
+    // The acquisition ends after the last frame, or when we return false
+    if ((lastFrame || !ret) &&
+        sequenceState_.Transition(AcqState_Running, AcqState_Stopping)) {
+        BeginTeardown(sequenceState_.TakeAcquisition(), false,
+                      ret ? AcqState_Finished : AcqState_Failed);
+    }
+    return ret;
+}
+
+bool OpenScan::InsertSequenceImage(uint32_t chan, void *pixels,
+                                   const CaptureTag *capture) {
+    char cameraName[MM::MaxStrLength];
+    GetChannelName(chan, cameraName);
+
+    // To work like Multi Camera, we must include the camera channel index. The
+    // metadata key for this is (for legacy reasons?) strange: it must include
+    // the device label of the camera.
+    // We also generate tags without the device label.
+    char myLabel[MM::MaxStrLength + 1];
+    GetLabel(myLabel);
+    std::string deviceTaggedChannelIndex(myLabel);
+    deviceTaggedChannelIndex += '-';
+    deviceTaggedChannelIndex += MM::g_Keyword_CameraChannelIndex;
+    std::string deviceTaggedChannelName(myLabel);
+    deviceTaggedChannelName += '-';
+    deviceTaggedChannelName += MM::g_Keyword_CameraChannelName;
+
+    char chanName[MM::MaxStrLength + 1]{};
+    GetChannelName(chan, chanName);
+
+    Metadata md;
+    md.put(deviceTaggedChannelIndex.c_str(), chan);
+    md.put(MM::g_Keyword_CameraChannelIndex, chan);
+    if (strlen(chanName) > 0) {
+        md.put(deviceTaggedChannelName.c_str(), chanName);
+        md.put(MM::g_Keyword_CameraChannelName, chanName);
+    }
+    // Live previews are inserted meanwhile and carry no capture tags
+    if (capture) {
+        md.put(TAG_CaptureNumber, capture->capture);
+        md.put(TAG_CaptureFrameIndex, capture->frame);
+        md.put(TAG_CaptureFrameCount, capture->frames);
+    }
+
+    unsigned width = sequenceGeometry_.width;
+    unsigned height = sequenceGeometry_.height;
+    unsigned bytesPerPixel = sequenceGeometry_.bytesPerPixel;
+    unsigned char *p = static_cast<unsigned char *>(pixels);
+    OSCMM_TRACE_BEGIN("InsertImage", chan);
+    int err = GetCoreCallback()->InsertImage(
+        this, p, width, height, bytesPerPixel, md.Serialize().c_str());
+    OSCMM_TRACE_END("InsertImage", err);
+    bool overflowed = err == DEVICE_BUFFER_OVERFLOW;
+    if (overflowed)
+        ++metrics_.overflowEvents;
+    if (!sequenceAcquisitionStopOnOverflow_ && overflowed) {
+        GetCoreCallback()->ClearImageBuffer(this);
+        err = GetCoreCallback()->InsertImage(this, p, width, height,
+                                             bytesPerPixel,
+                                             md.Serialize().c_str(), false);
+    }
+    if (err != DEVICE_OK) {
+        ++metrics_.imagesDropped;
+        if (overflowed)
+            ++metrics_.imagesDroppedOnOverflow;
+        return false;
+    }
+    ++metrics_.imagesInserted;
+    if (chan == 0)
+        ++metrics_.framesDelivered;
+    return true;
+}
+
+bool OpenScan::IsCapturing() {
+    // Read the flag first: a queued start clears it only after the state
+    // has moved to Arming
+    if (startQueued_ || sequenceState_.IsCapturing())
+        return true;
+    // Buffered frames are still being inserted
+    return teardownDelivers_ &&
+           sequenceState_.State() == AcqState_Stopping;
+}
+
+int OpenScan::OnStringProperty(MM::PropertyBase *pProp, MM::ActionType eAct,
+                               long data) {
+    OSc_RichError *err;
+    OSc_Setting *setting = settingIndex_[data];
+    if (eAct == MM::BeforeGet) {
+        char value[OSc_MAX_STR_LEN + 1];
+        err = OSc_Setting_GetStringValue(setting, value);
+        pProp->Set(value);
+    } else if (eAct == MM::AfterSet) {
+        TemplateChange change(this);
+        std::string value;
+        pProp->Get(value);
+        err = OSc_Setting_SetStringValue(setting, value.c_str());
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnBoolProperty(MM::PropertyBase *pProp, MM::ActionType eAct,
+                             long data) {
+    OSc_RichError *err;
+    OSc_Setting *setting = settingIndex_[data];
+    if (eAct == MM::BeforeGet) {
+        bool value;
+        err = OSc_Setting_GetBoolValue(setting, &value);
+        pProp->Set(value ? VALUE_Yes : VALUE_No);
+    } else if (eAct == MM::AfterSet) {
+        TemplateChange change(this);
+        std::string value;
+        pProp->Get(value);
+        err = OSc_Setting_SetBoolValue(setting, value == VALUE_Yes);
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnInt32Property(MM::PropertyBase *pProp, MM::ActionType eAct,
+                              long data) {
+    OSc_RichError *err;
+    OSc_Setting *setting = settingIndex_[data];
+    if (eAct == MM::BeforeGet) {
+        int32_t value;
+        err = OSc_Setting_GetInt32Value(setting, &value);
+        pProp->Set(static_cast<long>(value));
+    } else if (eAct == MM::AfterSet) {
+        TemplateChange change(this);
+        long value;
+        pProp->Get(value);
+        err = OSc_Setting_SetInt32Value(setting, static_cast<int32_t>(value));
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnFloat64Property(MM::PropertyBase *pProp, MM::ActionType eAct,
+                                long data) {
+    OSc_RichError *err;
+    OSc_Setting *setting = settingIndex_[data];
+    if (eAct == MM::BeforeGet) {
+        double value;
+        err = OSc_Setting_GetFloat64Value(setting, &value);
+        pProp->Set(value);
+    } else if (eAct == MM::AfterSet) {
+        TemplateChange change(this);
+        double value;
+        pProp->Get(value);
+        err = OSc_Setting_SetFloat64Value(setting, value);
+        if (err)
+            return AdHocErrorCode(err);
+
+        // TEMPORARY: Special handling for Zoom change, which affect
+        // magnification. A proper interface should be added to OpenScan C API
+        // that allows us to subscribe to resolutionSetting changes.
+        char name[1024];
+        err = OSc_Setting_GetName(setting, name);
+        if (err)
+            return AdHocErrorCode(err);
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnEnumProperty(MM::PropertyBase *pProp, MM::ActionType eAct,
+                             long data) {
+    OSc_RichError *err;
+    OSc_Setting *setting = settingIndex_[data];
+    if (eAct == MM::BeforeGet) {
+        uint32_t value;
+        err = OSc_Setting_GetEnumValue(setting, &value);
+        char valueStr[OSc_MAX_STR_LEN + 1];
+        err = OSc_Setting_GetEnumNameForValue(setting, value, valueStr);
+        pProp->Set(valueStr);
+    } else if (eAct == MM::AfterSet) {
+        TemplateChange change(this);
+        std::string valueStr;
+        pProp->Get(valueStr);
+        uint32_t value;
+        err =
+            OSc_Setting_GetEnumValueForName(setting, &value, valueStr.c_str());
+        err = OSc_Setting_SetEnumValue(setting, value);
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnTraceDumpFileProperty(MM::PropertyBase *pProp,
+                                      MM::ActionType eAct) {
+    if (eAct == MM::AfterSet) {
+        std::string path;
+        pProp->Get(path);
+        if (path.empty())
+            return DEVICE_OK;
+        std::string errorMessage;
+        if (!TraceDumpChromeJson(path, errorMessage))
+            return AdHocErrorCode(errorMessage);
+        LogMessage("Trace written to " + path, true);
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnCallbackLatencyProperty(MM::PropertyBase *pProp,
+                                        MM::ActionType eAct, long data) {
+    if (eAct == MM::BeforeGet) {
+        const LatencyHistogram &hist =
+            *callbackLatency_[data / NUM_LATENCY_STATS];
+        double percentile = LATENCY_STATS[data % NUM_LATENCY_STATS].percentile;
+        uint64_t ns = percentile >= 100.0 ? hist.MaxNs()
+                                          : hist.PercentileNs(percentile);
+        pProp->Set(ns / 1000.0);
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnMetricsFileProperty(MM::PropertyBase *pProp,
+                                    MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(metricsFile_.c_str());
+    } else if (eAct == MM::AfterSet) {
+        pProp->Get(metricsFile_);
+        metricsExporter_->Start(metricsFile_,
+                                std::chrono::milliseconds(metricsIntervalMs_));
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnMetricsIntervalProperty(MM::PropertyBase *pProp,
+                                        MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(metricsIntervalMs_);
+    } else if (eAct == MM::AfterSet) {
+        pProp->Get(metricsIntervalMs_);
+        metricsExporter_->Start(metricsFile_,
+                                std::chrono::milliseconds(metricsIntervalMs_));
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnReportDirectoryProperty(MM::PropertyBase *pProp,
+                                        MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(reportDirectory_.c_str());
+    } else if (eAct == MM::AfterSet) {
+        pProp->Get(reportDirectory_);
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnDeviceLogLevelProperty(MM::PropertyBase *pProp,
+                                       MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        for (const auto &level : DEVICE_LOG_LEVELS) {
+            if (level.level == deviceLog_->GetMinLevel())
+                pProp->Set(level.name);
+        }
+    } else if (eAct == MM::AfterSet) {
+        std::string name;
+        pProp->Get(name);
+        for (const auto &level : DEVICE_LOG_LEVELS) {
+            if (name == level.name)
+                deviceLog_->SetMinLevel(level.level);
+        }
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnDeviceLogRateLimitProperty(MM::PropertyBase *pProp,
+                                           MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(static_cast<long>(deviceLog_->GetRateLimit()));
+    } else if (eAct == MM::AfterSet) {
+        long limit;
+        pProp->Get(limit);
+        deviceLog_->SetRateLimit(static_cast<uint32_t>(limit));
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnTriggerModeProperty(MM::PropertyBase *pProp,
+                                    MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(externalTrigger_ ? VALUE_TriggerExternal
+                                    : VALUE_TriggerInternal);
+    } else if (eAct == MM::AfterSet) {
+        std::string value;
+        pProp->Get(value);
+        bool external = (value == VALUE_TriggerExternal);
+        if (external == externalTrigger_)
+            return DEVICE_OK;
+        externalTrigger_ = external;
+        snapStartToFrame_.Reset();
+        DiscardPreArmed(true);
+        if (WantsAnyPreArm())
+            PreArmInBackground();
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnPreArmProperty(MM::PropertyBase *pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        for (const auto &mode : PRE_ARM_MODES) {
+            if (mode.kinds == preArmKinds_)
+                pProp->Set(mode.name);
+        }
+    } else if (eAct == MM::AfterSet) {
+        std::string name;
+        pProp->Get(name);
+        for (const auto &mode : PRE_ARM_MODES) {
+            if (name == mode.name && mode.kinds != preArmKinds_) {
+                preArmKinds_ = mode.kinds;
+                DiscardPreArmed(true);
+                if (WantsAnyPreArm())
+                    PreArmInBackground();
+            }
+        }
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnPreArmDebounceProperty(MM::PropertyBase *pProp,
+                                       MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(preArmDebounceMs_);
+    } else if (eAct == MM::AfterSet) {
+        pProp->Get(preArmDebounceMs_);
+        preArmDebouncer_->SetDelay(
+            std::chrono::milliseconds(preArmDebounceMs_));
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnPreArmCacheSizeProperty(MM::PropertyBase *pProp,
+                                        MM::ActionType eAct) {
+    std::lock_guard<std::mutex> lock(preArmMutex_);
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(static_cast<long>(preArmCache_.Capacity()));
+    } else if (eAct == MM::AfterSet) {
+        long size;
+        pProp->Get(size);
+        preArmCache_.SetCapacity(static_cast<std::size_t>(size));
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnSnapStartToFrameProperty(MM::PropertyBase *pProp,
+                                         MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet)
+        pProp->Set(metrics_.lastSnapStartToFrameNs / 1000.0);
+    return DEVICE_OK;
+}
+
+int OpenScan::OnAcquisitionStateProperty(MM::PropertyBase *pProp,
+                                         MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet)
+        pProp->Set(AcquisitionStateName(sequenceState_.State()));
+    return DEVICE_OK;
+}
+
+int OpenScan::OnBurstModeProperty(MM::PropertyBase *pProp,
+                                  MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(burstMode_ ? VALUE_Yes : VALUE_No);
+    } else if (eAct == MM::AfterSet) {
+        std::string value;
+        pProp->Get(value);
+        burstMode_ = (value == VALUE_Yes);
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnBurstPrefaultProperty(MM::PropertyBase *pProp,
+                                      MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(burstPrefault_ ? VALUE_Yes : VALUE_No);
+    } else if (eAct == MM::AfterSet) {
+        std::string value;
+        pProp->Get(value);
+        burstPrefault_ = (value == VALUE_Yes);
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnBurstMaxMemoryProperty(MM::PropertyBase *pProp,
+                                       MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(burstMaxMemoryMB_);
+    } else if (eAct == MM::AfterSet) {
+        pProp->Get(burstMaxMemoryMB_);
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnPreTriggerSecondsProperty(MM::PropertyBase *pProp,
+                                          MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(preTriggerSeconds_);
+    } else if (eAct == MM::AfterSet) {
+        pProp->Get(preTriggerSeconds_);
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnPostTriggerSecondsProperty(MM::PropertyBase *pProp,
+                                           MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(postTriggerSeconds_);
+    } else if (eAct == MM::AfterSet) {
+        pProp->Get(postTriggerSeconds_);
+    }
+    return DEVICE_OK;
+}
+
+int OpenScan::OnPreTriggerMaxMemoryProperty(MM::PropertyBase *pProp,
+                                            MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(preTriggerMaxMemoryMB_);
+    } else if (eAct == MM::AfterSet) {
+        pProp->Get(preTriggerMaxMemoryMB_);
+    }
+    return DEVICE_OK;
 }
 
-int OpenScan::SetROI(unsigned x, unsigned y, unsigned width, unsigned height) {
-    return AdHocErrorCode(
-        OSc_AcqTemplate_SetROI(acqTemplate_, x, y, width, height));
+int OpenScan::OnCaptureDirectoryProperty(MM::PropertyBase *pProp,
+                                         MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(captureDirectory_.c_str());
+    } else if (eAct == MM::AfterSet) {
+        pProp->Get(captureDirectory_);
+    }
+    return DEVICE_OK;
 }
 
-int OpenScan::GetROI(unsigned &x, unsigned &y, unsigned &xSize,
-                     unsigned &ySize) {
-    return AdHocErrorCode(
-        OSc_AcqTemplate_GetROI(acqTemplate_, &x, &y, &xSize, &ySize));
+int OpenScan::OnCaptureProperty(MM::PropertyBase *pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(captureInProgress_ ? VALUE_Capture : VALUE_CaptureIdle);
+    } else if (eAct == MM::AfterSet) {
+        std::string value;
+        pProp->Get(value);
+        if (value != VALUE_Capture)
+            return DEVICE_OK;
+        if (!ringActive_) {
+            return AdHocErrorCode(std::string("Capture requires live mode "
+                                              "with ") +
+                                  PROPERTY_PreTriggerSeconds + " set");
+        }
+        // A capture in progress is not restarted
+        if (!captureInProgress_.exchange(true))
+            captureRequested_ = true;
+    }
+    return DEVICE_OK;
 }
 
-int OpenScan::ClearROI() {
-    OSc_AcqTemplate_ResetROI(acqTemplate_);
+int OpenScan::OnSnapDuringLiveProperty(MM::PropertyBase *pProp,
+                                       MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(SNAP_DURING_LIVE_NAMES[snapDuringLive_]);
+    } else if (eAct == MM::AfterSet) {
+        std::string name;
+        pProp->Get(name);
+        for (int i = 0; i < NUM_SNAP_DURING_LIVE_MODES; ++i) {
+            if (name == SNAP_DURING_LIVE_NAMES[i])
+                snapDuringLive_ = static_cast<SnapDuringLive>(i);
+        }
+    }
     return DEVICE_OK;
 }
 
-extern "C" {
-static bool SequenceFrameCallback(OSc_Acquisition *acq, uint32_t chan,
-                                  void *pixels, void *data) {
-    OpenScan *self = static_cast<OpenScan *>(data);
-    return self->SendSequenceImage(acq, chan, pixels);
-}
+int OpenScan::OnLinePhaseOffsetProperty(MM::PropertyBase *pProp,
+                                        MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        // May have been updated by automatic estimation
+        pProp->Set(framePipeline_.GetLinePhase());
+    } else if (eAct == MM::AfterSet) {
+        double pixels;
+        pProp->Get(pixels);
+        framePipeline_.SetLinePhase(pixels);
+        snapPipeline_.SetLinePhase(pixels);
+    }
+    return DEVICE_OK;
 }
 
-int OpenScan::StartSequenceAcquisition(long count, double,
-                                       bool stopOnOverflow) {
-    // I cannot think of a reasonable situation
-    // when IsCapturing is false while sequenceAcquisition_ is true.
-    // possibly it means previous live mode is not stopped properly
-    // anyway remove sequenceAcquisition_ from if ocndition for now
-    // TODO: need to fully test whether this change is valid?
-    if (IsCapturing())
-        return DEVICE_CAMERA_BUSY_ACQUIRING;
-
-    if (count < 1)
-        return DEVICE_OK;
-
-    OSc_Acquisition *acq;
-    OSc_RichError *err = OSc_Acquisition_Create(&acq, acqTemplate_);
-
-    err = OSc_Acquisition_SetData(acq, this);
-    if (err)
-        return AdHocErrorCode(err);
-    err = OSc_Acquisition_SetNumberOfFrames(acq, count);
-    if (err)
-        return AdHocErrorCode(err);
-
-    err = OSc_Acquisition_SetFrameCallback(acq, SequenceFrameCallback);
-    if (err)
-        return AdHocErrorCode(err);
-
-    err = OSc_Acquisition_Arm(acq);
-    if (err)
-        return AdHocErrorCode(err);
-    GetCoreCallback()->PrepareForAcq(this);
-
-    err = OSc_Acquisition_Start(acq);
-    if (err)
-        return AdHocErrorCode(err);
-
-    sequenceAcquisition_ = acq;
-    sequenceAcquisitionStopOnOverflow_ = stopOnOverflow;
+int OpenScan::OnLinePhaseEstimateIntervalProperty(MM::PropertyBase *pProp,
+                                                  MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(
+            static_cast<long>(framePipeline_.GetLinePhaseEstimateInterval()));
+    } else if (eAct == MM::AfterSet) {
+        long frames;
+        pProp->Get(frames);
+        framePipeline_.SetLinePhaseEstimateInterval(static_cast<int>(frames));
+        snapPipeline_.SetLinePhaseEstimateInterval(static_cast<int>(frames));
+    }
+    return DEVICE_OK;
+}
 
+int OpenScan::OnTemporalMedianProperty(MM::PropertyBase *pProp,
+                                       MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(static_cast<long>(framePipeline_.GetMedianFrames()));
+    } else if (eAct == MM::AfterSet) {
+        long frames;
+        pProp->Get(frames);
+        framePipeline_.SetMedianFrames(static_cast<int>(frames));
+    }
     return DEVICE_OK;
 }
 
-int OpenScan::StopSequenceAcquisition() {
-    if (!oscLSM_)
-        return DEVICE_OK;
+int OpenScan::OnRecursiveFilterGainProperty(MM::PropertyBase *pProp,
+                                            MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(framePipeline_.GetRecursiveGain());
+    } else if (eAct == MM::AfterSet) {
+        double gain;
+        pProp->Get(gain);
+        framePipeline_.SetRecursiveGain(gain);
+    }
+    return DEVICE_OK;
+}
 
-    if (!IsCapturing() || !sequenceAcquisition_)
-        return DEVICE_OK;
+int OpenScan::OnSpatialFilterProperty(MM::PropertyBase *pProp,
+                                      MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        for (const auto &filter : SPATIAL_FILTERS) {
+            if (filter.filter == framePipeline_.GetSpatialFilter())
+                pProp->Set(filter.name);
+        }
+    } else if (eAct == MM::AfterSet) {
+        std::string name;
+        pProp->Get(name);
+        for (const auto &filter : SPATIAL_FILTERS) {
+            if (name == filter.name)
+                framePipeline_.SetSpatialFilter(filter.filter);
+        }
+    }
+    return DEVICE_OK;
+}
 
-    OSc_RichError *err = OSc_Acquisition_Stop(sequenceAcquisition_);
-    GetCoreCallback()->AcqFinished(this, DEVICE_OK);
-    err = OSc_Acquisition_Destroy(sequenceAcquisition_);
-    sequenceAcquisition_ = 0;
+int OpenScan::OnBinningProperty(MM::PropertyBase *pProp,
+                                 MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(static_cast<long>(binning_));
+    } else if (eAct == MM::AfterSet) {
+        long binning;
+        pProp->Get(binning);
+        if (binning == binning_)
+            return DEVICE_OK;
+        // Image size must not change under a running acquisition
+        if (IsCapturing()) {
+            pProp->Set(static_cast<long>(binning_));
+            return DEVICE_CAMERA_BUSY_ACQUIRING;
+        }
+        binning_ = static_cast<int>(binning);
+    }
+    return DEVICE_OK;
+}
 
+int OpenScan::OnBinningModeProperty(MM::PropertyBase *pProp,
+                                    MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        bool sum =
+            framePipeline_.GetBinningMode() == FramePipeline::BinningMode_Sum;
+        pProp->Set(sum ? VALUE_BinSum : VALUE_BinAverage);
+    } else if (eAct == MM::AfterSet) {
+        std::string value;
+        pProp->Get(value);
+        FramePipeline::BinningMode mode =
+            value == VALUE_BinSum ? FramePipeline::BinningMode_Sum
+                                  : FramePipeline::BinningMode_Average;
+        framePipeline_.SetBinningMode(mode);
+        snapPipeline_.SetBinningMode(mode);
+    }
     return DEVICE_OK;
 }
 
-bool OpenScan::SendSequenceImage(OSc_Acquisition *, uint32_t chan,
-                                 void *pixels) {
-    char cameraName[MM::MaxStrLength];
-    GetChannelName(chan, cameraName);
+int OpenScan::OnDetectorBitDepthProperty(MM::PropertyBase *pProp,
+                                         MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(detectorBitDepth_);
+    } else if (eAct == MM::AfterSet) {
+        pProp->Get(detectorBitDepth_);
+    }
+    return DEVICE_OK;
+}
 
-    // To work like Multi Camera, we must include the camera channel index. The
-    // metadata key for this is (for legacy reasons?) strange: it must include
-    // the device label of the camera.
-    // We also generate tags without the device label.
-    char myLabel[MM::MaxStrLength + 1];
-    GetLabel(myLabel);
-    std::string deviceTaggedChannelIndex(myLabel);
-    deviceTaggedChannelIndex += '-';
-    deviceTaggedChannelIndex += MM::g_Keyword_CameraChannelIndex;
-    std::string deviceTaggedChannelName(myLabel);
-    deviceTaggedChannelName += '-';
-    deviceTaggedChannelName += MM::g_Keyword_CameraChannelName;
+int OpenScan::OnOutputBitDepthProperty(MM::PropertyBase *pProp,
+                                       MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        for (const auto &output : OUTPUT_FORMATS) {
+            if (output.format == outputFormat_)
+                pProp->Set(output.name);
+        }
+    } else if (eAct == MM::AfterSet) {
+        std::string name;
+        pProp->Get(name);
+        FramePipeline::OutputFormat format = outputFormat_;
+        for (const auto &output : OUTPUT_FORMATS) {
+            if (name == output.name)
+                format = output.format;
+        }
+        if (format == outputFormat_)
+            return DEVICE_OK;
+        // Image size must not change under a running acquisition
+        if (IsCapturing()) {
+            for (const auto &output : OUTPUT_FORMATS) {
+                if (output.format == outputFormat_)
+                    pProp->Set(output.name);
+            }
+            return DEVICE_CAMERA_BUSY_ACQUIRING;
+        }
+        // Re-arms snaps for the new number of frames
+        TemplateChange change(this);
+        outputFormat_ = format;
+    }
+    return DEVICE_OK;
+}
 
-    char chanName[MM::MaxStrLength + 1]{};
-    GetChannelName(chan, chanName);
+int OpenScan::OnAccumulateFramesProperty(MM::PropertyBase *pProp,
+                                         MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(accumulateFrames_);
+    } else if (eAct == MM::AfterSet) {
+        long frames;
+        pProp->Get(frames);
+        if (frames == accumulateFrames_)
+            return DEVICE_OK;
+        // The pipelines of a running acquisition keep their frame count
+        if (IsCapturing()) {
+            pProp->Set(accumulateFrames_);
+            return DEVICE_CAMERA_BUSY_ACQUIRING;
+        }
+        // Re-arms snaps for the new number of frames
+        TemplateChange change(this);
+        accumulateFrames_ = frames;
+    }
+    return DEVICE_OK;
+}
 
-    Metadata md;
-    md.put(deviceTaggedChannelIndex.c_str(), chan);
-    md.put(MM::g_Keyword_CameraChannelIndex, chan);
-    if (strlen(chanName) > 0) {
-        md.put(deviceTaggedChannelName.c_str(), chanName);
-        md.put(MM::g_Keyword_CameraChannelName, chanName);
+int OpenScan::OnOutputConversionProperty(MM::PropertyBase *pProp,
+                                         MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        bool window = framePipeline_.GetConversion() ==
+                      FramePipeline::Conversion_Window;
+        pProp->Set(window ? VALUE_ConvertWindow : VALUE_ConvertShift);
+    } else if (eAct == MM::AfterSet) {
+        std::string value;
+        pProp->Get(value);
+        FramePipeline::Conversion conversion =
+            value == VALUE_ConvertWindow ? FramePipeline::Conversion_Window
+                                         : FramePipeline::Conversion_Shift;
+        framePipeline_.SetConversion(conversion);
+        snapPipeline_.SetConversion(conversion);
     }
+    return DEVICE_OK;
+}
 
-    unsigned width = GetImageWidth();
-    unsigned height = GetImageHeight();
-    unsigned bytesPerPixel = GetImageBytesPerPixel();
-    unsigned char *p = static_cast<unsigned char *>(pixels);
-    int err = GetCoreCallback()->InsertImage(
-        this, p, width, height, bytesPerPixel, md.Serialize().c_str());
-    if (!sequenceAcquisitionStopOnOverflow_ && err == DEVICE_BUFFER_OVERFLOW) {
-        GetCoreCallback()->ClearImageBuffer(this);
-        err = GetCoreCallback()->InsertImage(this, p, width, height,
-                                             bytesPerPixel,
-                                             md.Serialize().c_str(), false);
-        return err == DEVICE_OK;
-    } else if (err != DEVICE_OK) {
-        return false;
+int OpenScan::OnOutputWindowMinProperty(MM::PropertyBase *pProp,
+                                        MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(static_cast<long>(framePipeline_.GetWindowMin()));
+    } else if (eAct == MM::AfterSet) {
+        long min;
+        pProp->Get(min);
+        framePipeline_.SetWindowMin(static_cast<int32_t>(min));
+        snapPipeline_.SetWindowMin(static_cast<int32_t>(min));
     }
-    return true;
+    return DEVICE_OK;
 }
 
-bool OpenScan::IsCapturing() {
-    if (!oscLSM_)
-        return false;
+int OpenScan::OnOutputWindowMaxProperty(MM::PropertyBase *pProp,
+                                        MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(static_cast<long>(framePipeline_.GetWindowMax()));
+    } else if (eAct == MM::AfterSet) {
+        long max;
+        pProp->Get(max);
+        framePipeline_.SetWindowMax(static_cast<int32_t>(max));
+        snapPipeline_.SetWindowMax(static_cast<int32_t>(max));
+    }
+    return DEVICE_OK;
+}
 
-    bool isRunning;
-    OSc_RichError *err = OSc_LSM_IsRunningAcquisition(oscLSM_, &isRunning);
-    if (err != OSc_OK)
-        return false;
-    return isRunning;
+int OpenScan::OnScanTurnaroundProperty(MM::PropertyBase *pProp,
+                                       MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(scanTurnaroundUs_);
+    } else if (eAct == MM::AfterSet) {
+        pProp->Get(scanTurnaroundUs_);
+    }
+    return DEVICE_OK;
 }
 
-int OpenScan::OnStringProperty(MM::PropertyBase *pProp, MM::ActionType eAct,
-                               long data) {
-    OSc_RichError *err;
-    OSc_Setting *setting = settingIndex_[data];
+int OpenScan::OnFlatFieldCorrectionProperty(MM::PropertyBase *pProp,
+                                            MM::ActionType eAct) {
     if (eAct == MM::BeforeGet) {
-        char value[OSc_MAX_STR_LEN + 1];
-        err = OSc_Setting_GetStringValue(setting, value);
-        pProp->Set(value);
+        pProp->Set(flatFieldEnabled_ ? VALUE_Yes : VALUE_No);
     } else if (eAct == MM::AfterSet) {
         std::string value;
         pProp->Get(value);
-        err = OSc_Setting_SetStringValue(setting, value.c_str());
+        flatFieldEnabled_ = value == VALUE_Yes;
     }
     return DEVICE_OK;
 }
 
-int OpenScan::OnBoolProperty(MM::PropertyBase *pProp, MM::ActionType eAct,
-                             long data) {
-    OSc_RichError *err;
-    OSc_Setting *setting = settingIndex_[data];
+int OpenScan::OnCalibrationDirectoryProperty(MM::PropertyBase *pProp,
+                                             MM::ActionType eAct) {
     if (eAct == MM::BeforeGet) {
-        bool value;
-        err = OSc_Setting_GetBoolValue(setting, &value);
-        pProp->Set(value ? VALUE_Yes : VALUE_No);
+        pProp->Set(calibrationStore_.GetDirectory().c_str());
     } else if (eAct == MM::AfterSet) {
-        std::string value;
-        pProp->Get(value);
-        err = OSc_Setting_SetBoolValue(setting, value == VALUE_Yes);
+        std::string directory;
+        pProp->Get(directory);
+        calibrationStore_.SetDirectory(directory);
     }
     return DEVICE_OK;
 }
 
-int OpenScan::OnInt32Property(MM::PropertyBase *pProp, MM::ActionType eAct,
-                              long data) {
-    OSc_RichError *err;
-    OSc_Setting *setting = settingIndex_[data];
+int OpenScan::OnCalibrationFramesProperty(MM::PropertyBase *pProp,
+                                          MM::ActionType eAct) {
     if (eAct == MM::BeforeGet) {
-        int32_t value;
-        err = OSc_Setting_GetInt32Value(setting, &value);
-        pProp->Set(static_cast<long>(value));
+        pProp->Set(calibrationFrames_);
     } else if (eAct == MM::AfterSet) {
-        long value;
-        pProp->Get(value);
-        err = OSc_Setting_SetInt32Value(setting, static_cast<int32_t>(value));
+        pProp->Get(calibrationFrames_);
     }
     return DEVICE_OK;
 }
 
-int OpenScan::OnFloat64Property(MM::PropertyBase *pProp, MM::ActionType eAct,
-                                long data) {
-    OSc_RichError *err;
-    OSc_Setting *setting = settingIndex_[data];
+int OpenScan::OnCalibrateProperty(MM::PropertyBase *pProp,
+                                  MM::ActionType eAct) {
     if (eAct == MM::BeforeGet) {
-        double value;
-        err = OSc_Setting_GetFloat64Value(setting, &value);
-        pProp->Set(value);
+        pProp->Set(VALUE_CalibrateIdle);
     } else if (eAct == MM::AfterSet) {
-        double value;
+        std::string value;
         pProp->Get(value);
-        err = OSc_Setting_SetFloat64Value(setting, value);
-        if (err)
-            return AdHocErrorCode(err);
+        pProp->Set(VALUE_CalibrateIdle);
+        if (value == VALUE_CalibrateDark)
+            return RunCalibration(Calibration_Dark);
+        if (value == VALUE_CalibrateFlat)
+            return RunCalibration(Calibration_Flat);
+    }
+    return DEVICE_OK;
+}
 
-        // TEMPORARY: Special handling for Zoom change, which affect
-        // magnification. A proper interface should be added to OpenScan C API
-        // that allows us to subscribe to resolutionSetting changes.
-        char name[1024];
-        err = OSc_Setting_GetName(setting, name);
-        if (err)
-            return AdHocErrorCode(err);
+int OpenScan::OnStallTimeoutFactorProperty(MM::PropertyBase *pProp,
+                                           MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(stallTimeoutFactor_);
+    } else if (eAct == MM::AfterSet) {
+        pProp->Get(stallTimeoutFactor_);
     }
     return DEVICE_OK;
 }
 
-int OpenScan::OnEnumProperty(MM::PropertyBase *pProp, MM::ActionType eAct,
-                             long data) {
-    OSc_RichError *err;
-    OSc_Setting *setting = settingIndex_[data];
+int OpenScan::OnStallRecoveryProperty(MM::PropertyBase *pProp,
+                                      MM::ActionType eAct) {
     if (eAct == MM::BeforeGet) {
-        uint32_t value;
-        err = OSc_Setting_GetEnumValue(setting, &value);
-        char valueStr[OSc_MAX_STR_LEN + 1];
-        err = OSc_Setting_GetEnumNameForValue(setting, value, valueStr);
-        pProp->Set(valueStr);
+        pProp->Set(stallRecovery_ ? VALUE_Yes : VALUE_No);
     } else if (eAct == MM::AfterSet) {
-        std::string valueStr;
-        pProp->Get(valueStr);
-        uint32_t value;
-        err =
-            OSc_Setting_GetEnumValueForName(setting, &value, valueStr.c_str());
-        err = OSc_Setting_SetEnumValue(setting, value);
+        std::string value;
+        pProp->Get(value);
+        stallRecovery_ = (value == VALUE_Yes);
     }
     return DEVICE_OK;
 }
@@ -903,6 +3678,7 @@ int OpenScan::OnEnableDetectorProperty(MM::PropertyBase *pProp,
             OSc_AcqTemplate_IsDetectorDeviceEnabled(acqTemplate_, i);
         pProp->Set(enabled ? VALUE_Yes : VALUE_No);
     } else if (eAct == MM::AfterSet) {
+        TemplateChange change(this);
         std::string valueStr;
         pProp->Get(valueStr);
         bool enable = (valueStr == VALUE_Yes);
@@ -911,20 +3687,24 @@ int OpenScan::OnEnableDetectorProperty(MM::PropertyBase *pProp,
     return DEVICE_OK;
 }
 
-int OpenScan::AdHocErrorCode(OSc_RichError *richError) {
-    if (richError == OSc_OK)
-        return DEVICE_OK;
-
+std::string OpenScan::FormatRichError(OSc_RichError *richError) {
     std::string buffer;
     buffer.resize(MM::MaxStrLength);
     // buffer.data() is const until C++17
     OSc_Error_FormatRecursive(richError, &buffer[0], MM::MaxStrLength);
     OSc_Error_Destroy(richError);
     buffer.resize(std::strlen(buffer.data()));
-    return AdHocErrorCode(buffer);
+    return buffer;
+}
+
+int OpenScan::AdHocErrorCode(OSc_RichError *richError) {
+    if (richError == OSc_OK)
+        return DEVICE_OK;
+    return AdHocErrorCode(FormatRichError(richError));
 }
 
 int OpenScan::AdHocErrorCode(const std::string &message) {
+    ++metrics_.errors;
     int ret = nextAdHocErrorCode_++;
     if (nextAdHocErrorCode_ > MAX_ADHOC_ERROR_CODE)
         nextAdHocErrorCode_ = MIN_ADHOC_ERROR_CODE;
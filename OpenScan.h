@@ -1,11 +1,30 @@
 ﻿#pragma once
 
+#include "AcquisitionReport.h"
+#include "AcquisitionStateMachine.h"
+#include "AdapterMetrics.h"
+#include "BackgroundWorker.h"
+#include "AsyncLogQueue.h"
+#include "Debouncer.h"
 #include "DeviceBase.h"
 #include "DeviceThreads.h"
+#include "FlatField.h"
+#include "FramePipeline.h"
+#include "FrameSetBuffer.h"
+#include "LatencyHistogram.h"
+#include "MetricsExporter.h"
+#include "PreArmCache.h"
+#include "ScanLinearization.h"
+#include "StallWatchdog.h"
 
 #include <OpenScanLib.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -53,8 +72,184 @@ class OpenScan : public CCameraBase<OpenScan> {
     OSc_AcqTemplate *acqTemplate_;
 
     std::vector<void *> snappedImages_; // Memory manually managed
-    OSc_Acquisition *sequenceAcquisition_;
+    std::size_t snappedImageBytes_;     // Size of each of snappedImages_
+    // Owns the sequence acquisition; see AcquisitionStateMachine.h
+    AcquisitionStateMachine sequenceState_;
+    // Written only while arming
     bool sequenceAcquisitionStopOnOverflow_;
+    std::atomic<uint64_t> sequenceFramesReceived_; // All channels received
+    // Set while armed with a burst buffer or pre-trigger ring, whose frames
+    // reach the core during the teardown: the sequence then counts as
+    // capturing while Stopping, until AcqFinished has been signaled
+    std::atomic<bool> teardownDelivers_;
+
+    // Size of sequence images, fixed when arming; frames kept in buffers
+    // are inserted with it even if the properties change afterwards
+    struct ImageGeometry {
+        unsigned width, height, bytesPerPixel;
+        std::size_t Bytes() const {
+            return std::size_t(width) * height * bytesPerPixel;
+        }
+    };
+    ImageGeometry sequenceGeometry_; // Written only while arming
+
+    // Stopping and destroying the acquisition (which waits for the device)
+    // happen on this thread, as does any start queued meanwhile
+    std::unique_ptr<BackgroundWorker> teardownWorker_;
+    std::mutex queuedStartMutex_;
+    long queuedStartCount_;
+    bool queuedStartStopOnOverflow_;
+    std::atomic<bool> startQueued_;
+
+    // Snaps and setting changes in progress, for Busy()
+    std::atomic<int> busyOperations_;
+    std::atomic<int> templateChanges_;
+    std::atomic<int> snapsInProgress_;
+
+    // Acquisitions armed ahead of need by armWorker_, once settings have
+    // been quiet for the debounce delay (and always for snaps in external
+    // trigger mode). Nothing is armed while a snap or setting change is in
+    // progress; the mutex is held only to use the cache.
+    std::unique_ptr<BackgroundWorker> armWorker_;
+    std::unique_ptr<Debouncer> preArmDebouncer_;
+    std::mutex preArmMutex_;
+    PreArmCache preArmCache_;
+    std::atomic<unsigned> preArmKinds_; // Bit (1 << PreArmKind) per kind
+    long preArmDebounceMs_;
+    std::atomic<bool> externalTrigger_;
+    std::chrono::steady_clock::time_point snapStartTime_;
+    LatencyHistogram snapStartToFrame_;
+
+    // Marks the camera busy while the acquisition template or a device
+    // setting changes, releasing pre-armed acquisitions for the duration.
+    // Waits for a sequence teardown in progress to finish first.
+    class TemplateChange {
+        OpenScan *self_;
+
+      public:
+        explicit TemplateChange(OpenScan *self);
+        ~TemplateChange();
+        TemplateChange(const TemplateChange &) = delete;
+        TemplateChange &operator=(const TemplateChange &) = delete;
+    };
+
+    // Burst mode: finite sequences are copied into memory during the scan
+    // and inserted into the core afterwards. The buffer is allocated while
+    // arming and drained on the teardown thread.
+    bool burstMode_;
+    bool burstPrefault_;
+    long burstMaxMemoryMB_;
+    FrameSetBuffer burstBuffer_;
+
+    // Pre-trigger ring: in live mode, frames are kept in ringBuffer_ instead
+    // of being inserted into the core (apart from a low-rate preview). A
+    // capture writes out the frames kept from the last preTriggerSeconds_
+    // plus the following postTriggerSeconds_.
+    double preTriggerSeconds_;
+    double postTriggerSeconds_;
+    long preTriggerMaxMemoryMB_;
+    std::string captureDirectory_; // Empty to insert into the core
+    FrameSetBuffer ringBuffer_;
+    uint64_t ringPreFrames_; // Written while arming
+    uint64_t ringPostFrames_;
+    std::atomic<bool> ringActive_;
+    std::atomic<bool> captureRequested_;  // Until the callback takes it
+    std::atomic<bool> captureInProgress_; // Until written out
+    std::atomic<bool> ringResumeRequested_;
+    std::atomic<uint64_t> captureCount_; // Captures written so far
+    // Identifies the images of a capture in their metadata
+    struct CaptureTag {
+        uint64_t capture; // captureCount_ when written
+        uint64_t frame;   // Within the capture
+        uint64_t frames;
+    };
+    // Owned by the frame callback while the ring is in use
+    uint64_t ringStartFrame_; // First frame kept since the ring (re)started
+    bool ringFrozen_;         // While a capture is written out
+    bool capturePending_;     // Waiting for post-trigger frames
+    uint64_t captureStartFrame_;
+    uint64_t captureEndFrame_;
+    bool previewFrame_;
+    std::chrono::steady_clock::time_point lastPreviewTime_;
+
+    // Snaps during a sequence copy a frame set from liveFrames_, where the
+    // frame callback keeps the latest complete set in one slot while
+    // filling the other
+    enum SnapDuringLive {
+        SnapDuringLive_Busy, // Refuse, as for any busy camera
+        SnapDuringLive_NextFrame,
+        SnapDuringLive_LatestFrame,
+    };
+    SnapDuringLive snapDuringLive_;
+    FrameSetBuffer liveFrames_; // Allocated while arming
+    std::mutex liveFramesMutex_;
+    std::condition_variable liveFramesCv_;
+    bool liveFramesOpen_;          // Guarded by liveFramesMutex_
+    uint64_t liveFramesCompleted_; // Guarded by liveFramesMutex_
+    std::size_t liveLatestSlot_;   // Written by the callback under the mutex
+
+    // Filters applied to sequence frames; configured while arming
+    FramePipeline framePipeline_;
+
+    // Corrections, binning and output of snapped frames (no filters);
+    // configured before each snap starts
+    FramePipeline snapPipeline_;
+
+    // Software binning, applied to snapped and sequence frames; changed only
+    // when not capturing
+    int binning_;
+
+    // Output of 8-bit images from 16-bit samples, or of 32-bit float means;
+    // changed only when not capturing (conversion parameters are kept
+    // in the pipelines)
+    long detectorBitDepth_; // 0 to use OpenScanLib's sample size
+    FramePipeline::OutputFormat outputFormat_;
+    long accumulateFrames_; // For 32-bit output
+
+    double scanTurnaroundUs_; // Scan linearization; 0 disables
+    LinearizationCache linearizationTables_;
+
+    // Dark/flat correction. References are the mean of a series of snaps,
+    // which store raw frames while calibrating_ (also read on the pre-arm
+    // thread, through SnapFrames()).
+    bool flatFieldEnabled_;
+    long calibrationFrames_;
+    std::atomic<bool> calibrating_;
+    CalibrationStore calibrationStore_;
+
+    std::unique_ptr<StallWatchdog> stallWatchdog_;
+    double stallTimeoutFactor_; // Multiple of frame period; 0 disables
+    bool stallRecovery_;
+
+    // Time from frame callback to InsertImage return, per channel; reset at
+    // the start of each sequence acquisition
+    std::vector<std::unique_ptr<LatencyHistogram>> callbackLatency_;
+
+    AdapterMetrics metrics_;
+    std::unique_ptr<MetricsExporter> metricsExporter_;
+    std::string metricsFile_;
+    long metricsIntervalMs_;
+    // Used by the exporter thread only, to compute frame rate
+    uint64_t exportedFramesDelivered_;
+    std::chrono::steady_clock::time_point exportedTime_;
+
+    // Per-acquisition report, filled in at start and completed at the end
+    AcquisitionReport sequenceReport_;
+    SequenceCounts sequenceStartCounts_;
+    std::chrono::steady_clock::time_point sequenceStartTime_;
+    std::chrono::steady_clock::time_point lastFrameTime_; // Channel 0
+    std::string reportDirectory_;
+
+  public:
+    struct DeviceLogContext {
+        AsyncLogQueue *queue;
+        int source;
+    };
+
+  private:
+    // Device log messages are forwarded to the core from a background thread
+    std::unique_ptr<AsyncLogQueue> deviceLog_;
+    std::vector<std::unique_ptr<DeviceLogContext>> deviceLogContexts_;
 
   private: // Pre-init config
     std::map<std::string, OSc_Device *> clockDevices_;
@@ -87,8 +282,8 @@ class OpenScan : public CCameraBase<OpenScan> {
     virtual int GetChannelName(unsigned channel, char *name);
     virtual unsigned GetBitDepth() const;
 
-    virtual int GetBinning() const { return 1; }
-    virtual int SetBinning(int) { return DEVICE_OK; }
+    virtual int GetBinning() const { return binning_; }
+    virtual int SetBinning(int binSize);
     virtual double GetExposure() const { return 0.0; }
     virtual void SetExposure(double) {}
 
@@ -124,9 +319,78 @@ class OpenScan : public CCameraBase<OpenScan> {
                        long data);
     int OnEnableDetectorProperty(MM::PropertyBase *pProp, MM::ActionType eAct,
                                  long data);
+    int OnTraceDumpFileProperty(MM::PropertyBase *pProp, MM::ActionType eAct);
+    int OnCallbackLatencyProperty(MM::PropertyBase *pProp, MM::ActionType eAct,
+                                  long data);
+    int OnMetricsFileProperty(MM::PropertyBase *pProp, MM::ActionType eAct);
+    int OnMetricsIntervalProperty(MM::PropertyBase *pProp,
+                                  MM::ActionType eAct);
+    int OnReportDirectoryProperty(MM::PropertyBase *pProp,
+                                  MM::ActionType eAct);
+    int OnDeviceLogLevelProperty(MM::PropertyBase *pProp, MM::ActionType eAct);
+    int OnDeviceLogRateLimitProperty(MM::PropertyBase *pProp,
+                                     MM::ActionType eAct);
+    int OnTriggerModeProperty(MM::PropertyBase *pProp, MM::ActionType eAct);
+    int OnSnapStartToFrameProperty(MM::PropertyBase *pProp,
+                                   MM::ActionType eAct);
+    int OnPreArmProperty(MM::PropertyBase *pProp, MM::ActionType eAct);
+    int OnPreArmDebounceProperty(MM::PropertyBase *pProp, MM::ActionType eAct);
+    int OnPreArmCacheSizeProperty(MM::PropertyBase *pProp,
+                                  MM::ActionType eAct);
+    int OnAcquisitionStateProperty(MM::PropertyBase *pProp,
+                                   MM::ActionType eAct);
+    int OnBurstModeProperty(MM::PropertyBase *pProp, MM::ActionType eAct);
+    int OnBurstPrefaultProperty(MM::PropertyBase *pProp, MM::ActionType eAct);
+    int OnBurstMaxMemoryProperty(MM::PropertyBase *pProp,
+                                 MM::ActionType eAct);
+    int OnPreTriggerSecondsProperty(MM::PropertyBase *pProp,
+                                    MM::ActionType eAct);
+    int OnPostTriggerSecondsProperty(MM::PropertyBase *pProp,
+                                     MM::ActionType eAct);
+    int OnPreTriggerMaxMemoryProperty(MM::PropertyBase *pProp,
+                                      MM::ActionType eAct);
+    int OnCaptureDirectoryProperty(MM::PropertyBase *pProp,
+                                   MM::ActionType eAct);
+    int OnCaptureProperty(MM::PropertyBase *pProp, MM::ActionType eAct);
+    int OnSnapDuringLiveProperty(MM::PropertyBase *pProp,
+                                 MM::ActionType eAct);
+    int OnLinePhaseOffsetProperty(MM::PropertyBase *pProp,
+                                  MM::ActionType eAct);
+    int OnLinePhaseEstimateIntervalProperty(MM::PropertyBase *pProp,
+                                            MM::ActionType eAct);
+    int OnTemporalMedianProperty(MM::PropertyBase *pProp,
+                                 MM::ActionType eAct);
+    int OnRecursiveFilterGainProperty(MM::PropertyBase *pProp,
+                                      MM::ActionType eAct);
+    int OnSpatialFilterProperty(MM::PropertyBase *pProp, MM::ActionType eAct);
+    int OnBinningProperty(MM::PropertyBase *pProp, MM::ActionType eAct);
+    int OnBinningModeProperty(MM::PropertyBase *pProp, MM::ActionType eAct);
+    int OnDetectorBitDepthProperty(MM::PropertyBase *pProp,
+                                   MM::ActionType eAct);
+    int OnOutputBitDepthProperty(MM::PropertyBase *pProp,
+                                 MM::ActionType eAct);
+    int OnAccumulateFramesProperty(MM::PropertyBase *pProp,
+                                   MM::ActionType eAct);
+    int OnOutputConversionProperty(MM::PropertyBase *pProp,
+                                   MM::ActionType eAct);
+    int OnOutputWindowMinProperty(MM::PropertyBase *pProp,
+                                  MM::ActionType eAct);
+    int OnOutputWindowMaxProperty(MM::PropertyBase *pProp,
+                                  MM::ActionType eAct);
+    int OnScanTurnaroundProperty(MM::PropertyBase *pProp,
+                                 MM::ActionType eAct);
+    int OnFlatFieldCorrectionProperty(MM::PropertyBase *pProp,
+                                      MM::ActionType eAct);
+    int OnCalibrationDirectoryProperty(MM::PropertyBase *pProp,
+                                       MM::ActionType eAct);
+    int OnCalibrationFramesProperty(MM::PropertyBase *pProp,
+                                    MM::ActionType eAct);
+    int OnCalibrateProperty(MM::PropertyBase *pProp, MM::ActionType eAct);
+    int OnStallTimeoutFactorProperty(MM::PropertyBase *pProp,
+                                     MM::ActionType eAct);
+    int OnStallRecoveryProperty(MM::PropertyBase *pProp, MM::ActionType eAct);
 
   public: // Internal functions called from non-class context
-    void LogOpenScanMessage(const char *msg, OSc_LogLevel level);
     void StoreSnapImage(OSc_Acquisition *acq, uint32_t chan, void *pixels);
     bool SendSequenceImage(OSc_Acquisition *acq, uint32_t chan, void *pixels);
 
@@ -134,12 +398,75 @@ class OpenScan : public CCameraBase<OpenScan> {
     int GetMagnification(double *magnification);
 
   private:
+    // Destroys the error
+    static std::string FormatRichError(OSc_RichError *richError);
     int AdHocErrorCode(OSc_RichError *richError);
     int AdHocErrorCode(const std::string &message);
     int GenerateProperties();
     int GenerateProperties(OSc_Setting **settings, size_t count,
                            OSc_Device *device);
+    int GenerateLatencyProperties();
+    int GenerateBinningProperties();
+    int GenerateOutputProperties();
+    int GenerateDeviceLogProperties();
+    int GenerateTriggerProperties();
+    int GeneratePreArmProperties();
+    int GenerateBurstProperties();
+    int GeneratePreTriggerProperties();
+    int GenerateSnapDuringLiveProperty();
+    int GenerateProcessingProperties();
+    int GenerateLinearizationProperties();
+    int GenerateCalibrationProperties();
+    int GenerateStallWatchdogProperties();
+    std::string FormatPrometheusMetrics();
+    std::string CaptureAcquisitionConfig(AcquisitionReport &report);
+    OSc_RichError *CreateSnapAcquisition(OSc_Acquisition **acq);
+    OSc_RichError *
+    PrepareLinearization(std::shared_ptr<const LinearizationTable> &table);
+    OSc_RichError *CalibrationKey(std::string &key);
+    OSc_RichError *ConfigurePipeline(FramePipeline &pipeline,
+                                     std::size_t channels);
+    unsigned ScanWidth() const;
+    unsigned ScanHeight() const;
+    unsigned SampleBytes() const;
+    unsigned ImageBinning() const;
+    unsigned SampleBits() const;
+    uint32_t SnapFrames() const;
+    OSc_RichError *PrepareFlatField(CalibrationStore::Correctors &correctors);
+    int RunCalibration(CalibrationKind kind);
+    int SnapFromSequence();
+    void PublishLiveFrame();
+    OSc_RichError *TemplateKey(std::string &key);
+    bool WantsPreArm(PreArmKind kind) const;
+    bool WantsAnyPreArm() const;
+    void PreArmInBackground();
+    OSc_Acquisition *TakePreArmed(PreArmKind kind); // Caller holds mutex
+    // Destroys all, or only enough to leave room for arming one more
+    void DiscardPreArmed(bool all);
+    OSc_RichError *CreateSequenceAcquisition(long count,
+                                             OSc_Acquisition **acq);
+    std::string ArmAndStartSequence(long count, bool stopOnOverflow);
+    OSc_RichError *StartArmedAcquisition(OSc_Acquisition *acq,
+                                         bool &stillArming);
+    std::string AllocateBurstBuffer(long count);
+    void DrainBurstBuffer();
+    std::string AllocateRingBuffer();
+    bool StoreRingImage(uint32_t chan, void *pixels);
+    void AdvanceRing(uint64_t framesReceived);
+    void WriteCapture(uint64_t startFrame, uint64_t endFrame);
+    void FinishRing();
+    void ReleaseSequenceBuffers();
+    OSc_RichError *EstimateFramePeriod(double &seconds);
+    std::chrono::milliseconds StallTimeout();
+    void RecoverStalledAcquisition(std::chrono::milliseconds stalledFor);
+    void BeginTeardown(OSc_Acquisition *acq, bool stoppedByUser,
+                       AcquisitionState endState);
+    void FinishSequenceAcquisition(bool stoppedByUser,
+                                   AcquisitionState endState);
+    void CompleteAcquisitionReport(bool stoppedByUser);
     void DiscardPreviouslySnappedImages();
+    bool InsertSequenceImage(uint32_t chan, void *pixels,
+                             const CaptureTag *capture = nullptr);
 };
 
 // Magnifier for scaling pixel size with respect to resolution and zoom change
@@ -0,0 +1,621 @@
+#include "PixelKernels.h"
+
+#include "FramePipeline.h"
+
+#include <algorithm>
+#include <limits>
+
+#if !defined(OPENSCAN_MM_NO_SIMD) &&                                       \
+    (defined(__SSE2__) || defined(_M_X64) ||                              \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define PIXEL_KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+// Each kernel runs its SSE2 loop over whole vectors of samples and leaves
+// the rest of the frame to the scalar version.
+
+namespace {
+
+template <typename T> void CompareExchangeScalar(T *a, T *b, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        T lo = std::min(a[i], b[i]);
+        T hi = std::max(a[i], b[i]);
+        a[i] = lo;
+        b[i] = hi;
+    }
+}
+
+// Whole input rows are first added up into colSums, so that both passes of
+// binning are straight loops
+template <typename T>
+void SumColumnsScalar(const T *row, std::size_t inWidth, unsigned rows,
+                      uint32_t *colSums, std::size_t n) {
+    for (std::size_t x = 0; x < n; ++x)
+        colSums[x] = row[x];
+    for (unsigned r = 1; r < rows; ++r) {
+        row += inWidth;
+        for (std::size_t x = 0; x < n; ++x)
+            colSums[x] += row[x];
+    }
+}
+
+template <typename T, unsigned Factor>
+void BinRowScalar(const uint32_t *colSums, T *out, std::size_t width,
+                  bool sum) {
+    const uint32_t maxValue = std::numeric_limits<T>::max();
+    const unsigned shift = Factor == 2 ? 2 : Factor == 4 ? 4 : 6;
+    const uint32_t half = (1u << shift) / 2;
+    for (std::size_t x = 0; x < width; ++x) {
+        uint32_t v = 0;
+        for (unsigned k = 0; k < Factor; ++k)
+            v += colSums[x * Factor + k];
+        out[x] = T(sum ? std::min(v, maxValue) : (v + half) >> shift);
+    }
+}
+
+void ShiftTo8BitScalar(const uint16_t *in, uint8_t *out, std::size_t n,
+                       unsigned shift) {
+    for (std::size_t i = 0; i < n; ++i)
+        out[i] = uint8_t(std::min(uint32_t(in[i]) >> shift, 255u));
+}
+
+// In 16-bit fixed point, clamping first so that the product fits in 32
+// bits
+void WindowTo8BitScalar(const uint16_t *in, uint8_t *out, std::size_t n,
+                        uint32_t min, uint32_t max, uint32_t scale) {
+    for (std::size_t i = 0; i < n; ++i) {
+        uint32_t v = std::min(std::max(uint32_t(in[i]), min), max) - min;
+        out[i] = uint8_t((v * scale + (1u << 15)) >> 16);
+    }
+}
+
+template <typename T>
+void WidenFrameScalar(const T *in, uint32_t *sum, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i)
+        sum[i] = in[i];
+}
+
+template <typename T>
+void AddFrameScalar(const T *in, uint32_t *sum, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i)
+        sum[i] += in[i];
+}
+
+template <typename T>
+void ReplaceFrameScalar(const T *in, T *oldest, uint32_t *sum,
+                        std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        sum[i] = sum[i] - oldest[i] + in[i];
+        oldest[i] = in[i];
+    }
+}
+
+void MeanToFloatScalar(const uint32_t *sum, float *out, std::size_t n,
+                       float scale) {
+    for (std::size_t i = 0; i < n; ++i)
+        out[i] = float(int32_t(sum[i])) * scale;
+}
+
+// Running averages keep this many fractional bits, leaving room for the
+// gain multiplication in 32 bits with 16-bit samples
+const int AVERAGE_FRACTION_BITS = 4;
+
+template <typename T>
+void PrimeAverageScalar(const T *in, int32_t *average, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i)
+        average[i] = int32_t(in[i]) << AVERAGE_FRACTION_BITS;
+}
+
+template <typename T>
+void RecursiveFilterScalar(const T *in, int32_t *average, T *out,
+                           std::size_t n, int32_t gain) {
+    const int32_t round = 1 << (FramePipeline::GAIN_BITS - 1);
+    const int32_t half = 1 << (AVERAGE_FRACTION_BITS - 1);
+    for (std::size_t i = 0; i < n; ++i) {
+        int32_t x = int32_t(in[i]) << AVERAGE_FRACTION_BITS;
+        int32_t a = average[i];
+        a += ((x - a) * gain + round) >> FramePipeline::GAIN_BITS;
+        average[i] = a;
+        out[i] = T((a + half) >> AVERAGE_FRACTION_BITS);
+    }
+}
+
+#ifdef PIXEL_KERNELS_SSE2
+
+// Samples i to i + 7 in 16-bit lanes, and back (8-bit lanes must hold
+// values up to 255)
+inline __m128i Load8(const uint16_t *p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+
+inline __m128i Load8(const uint8_t *p) {
+    __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+    return _mm_unpacklo_epi8(v, _mm_setzero_si128());
+}
+
+inline void Store8(uint16_t *p, __m128i v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+}
+
+inline void Store8(uint8_t *p, __m128i v) {
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(p), _mm_packus_epi16(v, v));
+}
+
+// Unsigned 16-bit minimum and maximum, which SSE2 lacks, from the
+// saturating difference
+inline __m128i Min16(__m128i a, __m128i b) {
+    return _mm_sub_epi16(a, _mm_subs_epu16(a, b));
+}
+
+inline __m128i Max16(__m128i a, __m128i b) {
+    return _mm_add_epi16(b, _mm_subs_epu16(a, b));
+}
+
+inline __m128i Load4(const int32_t *p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+
+inline __m128i Load4(const uint32_t *p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+
+inline void Store4(int32_t *p, __m128i v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+}
+
+inline void Store4(uint32_t *p, __m128i v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+}
+
+// Signed 32-bit minimum, which SSE2 lacks
+inline __m128i Min32(__m128i a, __m128i b) {
+    __m128i greater = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(greater, b),
+                        _mm_andnot_si128(greater, a));
+}
+
+// Sums of adjacent lanes: a0 + a1, a2 + a3, b0 + b1, b2 + b3
+inline __m128i AddPairs(__m128i a, __m128i b) {
+    __m128 fa = _mm_castsi128_ps(a);
+    __m128 fb = _mm_castsi128_ps(b);
+    __m128i even =
+        _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0)));
+    __m128i odd =
+        _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1)));
+    return _mm_add_epi32(even, odd);
+}
+
+// 32-bit lanes holding 0 to 65535 to 16 bits; SSE2 only packs with signed
+// saturation, so the values are biased into the signed range and back
+inline __m128i PackTo16(__m128i lo, __m128i hi) {
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16(-0x8000);
+    __m128i packed = _mm_packs_epi32(_mm_sub_epi32(lo, bias32),
+                                     _mm_sub_epi32(hi, bias32));
+    return _mm_xor_si128(packed, bias16);
+}
+
+// d * gain for |d| < 2^20 and 0 < gain < 2^15. SSE2 has no 32-bit multiply
+// (low half), so d is split into its low 15 bits and the (small, signed)
+// rest, and each part is multiplied by gain as 16-bit values.
+inline __m128i MultiplyGain(__m128i d, __m128i gain) {
+    __m128i low = _mm_and_si128(d, _mm_set1_epi32(0x7fff));
+    __m128i high = _mm_srai_epi32(d, 15);
+    return _mm_add_epi32(_mm_madd_epi16(low, gain),
+                         _mm_slli_epi32(_mm_madd_epi16(high, gain), 15));
+}
+
+std::size_t CompareExchangeSSE2(uint8_t *a, uint8_t *b, std::size_t n) {
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i *pa = reinterpret_cast<__m128i *>(a + i);
+        __m128i *pb = reinterpret_cast<__m128i *>(b + i);
+        __m128i va = _mm_loadu_si128(pa);
+        __m128i vb = _mm_loadu_si128(pb);
+        _mm_storeu_si128(pa, _mm_min_epu8(va, vb));
+        _mm_storeu_si128(pb, _mm_max_epu8(va, vb));
+    }
+    return i;
+}
+
+std::size_t CompareExchangeSSE2(uint16_t *a, uint16_t *b, std::size_t n) {
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i va = Load8(a + i);
+        __m128i vb = Load8(b + i);
+        Store8(a + i, Min16(va, vb));
+        Store8(b + i, Max16(va, vb));
+    }
+    return i;
+}
+
+template <typename T>
+std::size_t SumColumnsSSE2(const T *row, std::size_t inWidth, unsigned rows,
+                           uint32_t *colSums, std::size_t n) {
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t x = 0;
+    for (; x + 8 <= n; x += 8) {
+        __m128i lo = zero;
+        __m128i hi = zero;
+        for (unsigned r = 0; r < rows; ++r) {
+            __m128i v = Load8(row + r * inWidth + x);
+            lo = _mm_add_epi32(lo, _mm_unpacklo_epi16(v, zero));
+            hi = _mm_add_epi32(hi, _mm_unpackhi_epi16(v, zero));
+        }
+        Store4(colSums + x, lo);
+        Store4(colSums + x + 4, hi);
+    }
+    return x;
+}
+
+// Sums of 4 consecutive blocks of Factor column sums, by adding adjacent
+// lanes Factor / 2 times
+template <unsigned Factor> __m128i BlockSums(const uint32_t *colSums);
+
+template <> inline __m128i BlockSums<1>(const uint32_t *colSums) {
+    return Load4(colSums);
+}
+
+template <unsigned Factor> __m128i BlockSums(const uint32_t *colSums) {
+    return AddPairs(BlockSums<Factor / 2>(colSums),
+                    BlockSums<Factor / 2>(colSums + 2 * Factor));
+}
+
+// Block sums of up to 64 16-bit samples are below 2^31, so they can be
+// compared and shifted as signed values
+template <typename T, unsigned Factor>
+std::size_t BinRowSSE2(const uint32_t *colSums, T *out, std::size_t width,
+                       bool sum) {
+    const int shift = Factor == 2 ? 2 : Factor == 4 ? 4 : 6;
+    const __m128i maxValue = _mm_set1_epi32(std::numeric_limits<T>::max());
+    const __m128i half = _mm_set1_epi32((1 << shift) / 2);
+    std::size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i lo = BlockSums<Factor>(colSums + x * Factor);
+        __m128i hi = BlockSums<Factor>(colSums + (x + 4) * Factor);
+        if (sum) {
+            lo = Min32(lo, maxValue);
+            hi = Min32(hi, maxValue);
+        } else {
+            lo = _mm_srli_epi32(_mm_add_epi32(lo, half), shift);
+            hi = _mm_srli_epi32(_mm_add_epi32(hi, half), shift);
+        }
+        Store8(out + x, PackTo16(lo, hi));
+    }
+    return x;
+}
+
+std::size_t ShiftTo8BitSSE2(const uint16_t *in, uint8_t *out, std::size_t n,
+                            unsigned shift) {
+    const __m128i count = _mm_cvtsi32_si128(int(shift));
+    const __m128i max = _mm_set1_epi16(255);
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i lo = Min16(_mm_srl_epi16(Load8(in + i), count), max);
+        __m128i hi = Min16(_mm_srl_epi16(Load8(in + i + 8), count), max);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                         _mm_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+// The clamped value v is at most max - min, so v * scale is at most
+// 255 << 16. With scale split into 16-bit halves, the rounded product
+// shifted right by 16 is v * high + the high half of v * low, plus one if
+// the low half of v * low is at least 2^15; each term fits in 16 bits.
+std::size_t WindowTo8BitSSE2(const uint16_t *in, uint8_t *out, std::size_t n,
+                             uint32_t min, uint32_t max, uint32_t scale) {
+    const __m128i vmin = _mm_set1_epi16(short(min));
+    const __m128i range = _mm_set1_epi16(short(max - min));
+    const __m128i low = _mm_set1_epi16(short(scale & 0xffff));
+    const __m128i high = _mm_set1_epi16(short(scale >> 16));
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i result[2];
+        for (int h = 0; h < 2; ++h) {
+            // min(max(x, min), max) - min
+            __m128i v = Min16(_mm_subs_epu16(Load8(in + i + 8 * h), vmin),
+                              range);
+            __m128i carry = _mm_srli_epi16(_mm_mullo_epi16(v, low), 15);
+            result[h] = _mm_add_epi16(
+                _mm_add_epi16(_mm_mulhi_epu16(v, low), carry),
+                _mm_mullo_epi16(v, high));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                         _mm_packus_epi16(result[0], result[1]));
+    }
+    return i;
+}
+
+template <typename T>
+std::size_t WidenFrameSSE2(const T *in, uint32_t *sum, std::size_t n) {
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = Load8(in + i);
+        Store4(sum + i, _mm_unpacklo_epi16(x, zero));
+        Store4(sum + i + 4, _mm_unpackhi_epi16(x, zero));
+    }
+    return i;
+}
+
+template <typename T>
+std::size_t AddFrameSSE2(const T *in, uint32_t *sum, std::size_t n) {
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = Load8(in + i);
+        Store4(sum + i, _mm_add_epi32(Load4(sum + i),
+                                      _mm_unpacklo_epi16(x, zero)));
+        Store4(sum + i + 4, _mm_add_epi32(Load4(sum + i + 4),
+                                          _mm_unpackhi_epi16(x, zero)));
+    }
+    return i;
+}
+
+template <typename T>
+std::size_t ReplaceFrameSSE2(const T *in, T *oldest, uint32_t *sum,
+                             std::size_t n) {
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = Load8(in + i);
+        __m128i old = Load8(oldest + i);
+        __m128i lo = _mm_sub_epi32(_mm_unpacklo_epi16(x, zero),
+                                   _mm_unpacklo_epi16(old, zero));
+        __m128i hi = _mm_sub_epi32(_mm_unpackhi_epi16(x, zero),
+                                   _mm_unpackhi_epi16(old, zero));
+        Store4(sum + i, _mm_add_epi32(Load4(sum + i), lo));
+        Store4(sum + i + 4, _mm_add_epi32(Load4(sum + i + 4), hi));
+        Store8(oldest + i, x);
+    }
+    return i;
+}
+
+std::size_t MeanToFloatSSE2(const uint32_t *sum, float *out, std::size_t n,
+                            float scale) {
+    const __m128 s = _mm_set1_ps(scale);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 mean = _mm_mul_ps(_mm_cvtepi32_ps(Load4(sum + i)), s);
+        _mm_storeu_ps(out + i, mean);
+    }
+    return i;
+}
+
+template <typename T>
+std::size_t PrimeAverageSSE2(const T *in, int32_t *average, std::size_t n) {
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = Load8(in + i);
+        Store4(average + i, _mm_slli_epi32(_mm_unpacklo_epi16(x, zero),
+                                           AVERAGE_FRACTION_BITS));
+        Store4(average + i + 4, _mm_slli_epi32(_mm_unpackhi_epi16(x, zero),
+                                               AVERAGE_FRACTION_BITS));
+    }
+    return i;
+}
+
+inline __m128i UpdateAverage(__m128i x, int32_t *average, __m128i gain) {
+    const __m128i round = _mm_set1_epi32(1 << (FramePipeline::GAIN_BITS - 1));
+    const __m128i half = _mm_set1_epi32(1 << (AVERAGE_FRACTION_BITS - 1));
+    x = _mm_slli_epi32(x, AVERAGE_FRACTION_BITS);
+    __m128i a = Load4(average);
+    __m128i step = MultiplyGain(_mm_sub_epi32(x, a), gain);
+    a = _mm_add_epi32(a, _mm_srai_epi32(_mm_add_epi32(step, round),
+                                        FramePipeline::GAIN_BITS));
+    Store4(average, a);
+    return _mm_srai_epi32(_mm_add_epi32(a, half), AVERAGE_FRACTION_BITS);
+}
+
+template <typename T>
+std::size_t RecursiveFilterSSE2(const T *in, int32_t *average, T *out,
+                                std::size_t n, int32_t gain) {
+    const __m128i zero = _mm_setzero_si128();
+    // In the low 16 bits of each lane, for MultiplyGain()
+    const __m128i g = _mm_set1_epi32(gain);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = Load8(in + i);
+        __m128i lo =
+            UpdateAverage(_mm_unpacklo_epi16(x, zero), average + i, g);
+        __m128i hi =
+            UpdateAverage(_mm_unpackhi_epi16(x, zero), average + i + 4, g);
+        Store8(out + i, PackTo16(lo, hi));
+    }
+    return i;
+}
+
+#endif // PIXEL_KERNELS_SSE2
+
+template <typename T> void CompareExchangeImpl(T *a, T *b, std::size_t n) {
+    std::size_t i = 0;
+#ifdef PIXEL_KERNELS_SSE2
+    i = CompareExchangeSSE2(a, b, n);
+#endif
+    CompareExchangeScalar(a + i, b + i, n - i);
+}
+
+template <typename T, unsigned Factor>
+void BinBlocksImpl(const T *in, std::size_t inWidth, T *out,
+                   std::size_t width, std::size_t height, bool sum,
+                   uint32_t *colSums) {
+    std::size_t used = width * Factor;
+    for (std::size_t y = 0; y < height; ++y) {
+        const T *row = in + y * Factor * inWidth;
+        T *dst = out + y * width;
+        std::size_t x = 0;
+        std::size_t b = 0;
+#ifdef PIXEL_KERNELS_SSE2
+        x = SumColumnsSSE2(row, inWidth, Factor, colSums, used);
+#endif
+        SumColumnsScalar(row + x, inWidth, Factor, colSums + x, used - x);
+#ifdef PIXEL_KERNELS_SSE2
+        b = BinRowSSE2<T, Factor>(colSums, dst, width, sum);
+#endif
+        BinRowScalar<T, Factor>(colSums + b * Factor, dst + b, width - b,
+                                sum);
+    }
+}
+
+template <typename T>
+void BinBlocksImpl(const T *in, std::size_t inWidth, T *out,
+                   std::size_t width, std::size_t height, unsigned factor,
+                   bool sum, uint32_t *colSums) {
+    switch (factor) {
+    case 2:
+        return BinBlocksImpl<T, 2>(in, inWidth, out, width, height, sum,
+                                   colSums);
+    case 4:
+        return BinBlocksImpl<T, 4>(in, inWidth, out, width, height, sum,
+                                   colSums);
+    default:
+        return BinBlocksImpl<T, 8>(in, inWidth, out, width, height, sum,
+                                   colSums);
+    }
+}
+
+template <typename T>
+void WidenFrameImpl(const T *in, uint32_t *sum, std::size_t n) {
+    std::size_t i = 0;
+#ifdef PIXEL_KERNELS_SSE2
+    i = WidenFrameSSE2(in, sum, n);
+#endif
+    WidenFrameScalar(in + i, sum + i, n - i);
+}
+
+template <typename T>
+void AddFrameImpl(const T *in, uint32_t *sum, std::size_t n) {
+    std::size_t i = 0;
+#ifdef PIXEL_KERNELS_SSE2
+    i = AddFrameSSE2(in, sum, n);
+#endif
+    AddFrameScalar(in + i, sum + i, n - i);
+}
+
+template <typename T>
+void ReplaceFrameImpl(const T *in, T *oldest, uint32_t *sum, std::size_t n) {
+    std::size_t i = 0;
+#ifdef PIXEL_KERNELS_SSE2
+    i = ReplaceFrameSSE2(in, oldest, sum, n);
+#endif
+    ReplaceFrameScalar(in + i, oldest + i, sum + i, n - i);
+}
+
+template <typename T>
+void PrimeAverageImpl(const T *in, int32_t *average, std::size_t n) {
+    std::size_t i = 0;
+#ifdef PIXEL_KERNELS_SSE2
+    i = PrimeAverageSSE2(in, average, n);
+#endif
+    PrimeAverageScalar(in + i, average + i, n - i);
+}
+
+template <typename T>
+void RecursiveFilterImpl(const T *in, int32_t *average, T *out,
+                         std::size_t n, int32_t gain) {
+    std::size_t i = 0;
+#ifdef PIXEL_KERNELS_SSE2
+    i = RecursiveFilterSSE2(in, average, out, n, gain);
+#endif
+    RecursiveFilterScalar(in + i, average + i, out + i, n - i, gain);
+}
+
+} // namespace
+
+void ShiftTo8Bit(const uint16_t *in, uint8_t *out, std::size_t n,
+                 unsigned shift) {
+    std::size_t i = 0;
+#ifdef PIXEL_KERNELS_SSE2
+    i = ShiftTo8BitSSE2(in, out, n, shift);
+#endif
+    ShiftTo8BitScalar(in + i, out + i, n - i, shift);
+}
+
+void WindowTo8Bit(const uint16_t *in, uint8_t *out, std::size_t n,
+                  uint32_t min, uint32_t max) {
+    uint32_t scale = (255u << 16) / (max - min);
+    std::size_t i = 0;
+#ifdef PIXEL_KERNELS_SSE2
+    i = WindowTo8BitSSE2(in, out, n, min, max, scale);
+#endif
+    WindowTo8BitScalar(in + i, out + i, n - i, min, max, scale);
+}
+
+void WidenFrame(const uint8_t *in, uint32_t *sum, std::size_t n) {
+    WidenFrameImpl(in, sum, n);
+}
+
+void WidenFrame(const uint16_t *in, uint32_t *sum, std::size_t n) {
+    WidenFrameImpl(in, sum, n);
+}
+
+void AddFrame(const uint8_t *in, uint32_t *sum, std::size_t n) {
+    AddFrameImpl(in, sum, n);
+}
+
+void AddFrame(const uint16_t *in, uint32_t *sum, std::size_t n) {
+    AddFrameImpl(in, sum, n);
+}
+
+void ReplaceFrame(const uint8_t *in, uint8_t *oldest, uint32_t *sum,
+                  std::size_t n) {
+    ReplaceFrameImpl(in, oldest, sum, n);
+}
+
+void ReplaceFrame(const uint16_t *in, uint16_t *oldest, uint32_t *sum,
+                  std::size_t n) {
+    ReplaceFrameImpl(in, oldest, sum, n);
+}
+
+// Sums are below 2^31, so they are converted as signed, which SSE2 (and
+// the scalar conversion on x86) does in one instruction
+void MeanToFloat(const uint32_t *sum, float *out, std::size_t n,
+                 std::size_t count) {
+    float scale = 1.0f / float(count);
+    std::size_t i = 0;
+#ifdef PIXEL_KERNELS_SSE2
+    i = MeanToFloatSSE2(sum, out, n, scale);
+#endif
+    MeanToFloatScalar(sum + i, out + i, n - i, scale);
+}
+
+void CompareExchange(uint8_t *a, uint8_t *b, std::size_t n) {
+    CompareExchangeImpl(a, b, n);
+}
+
+void CompareExchange(uint16_t *a, uint16_t *b, std::size_t n) {
+    CompareExchangeImpl(a, b, n);
+}
+
+void BinBlocks(const uint8_t *in, std::size_t inWidth, uint8_t *out,
+               std::size_t width, std::size_t height, unsigned factor,
+               bool sum, uint32_t *colSums) {
+    BinBlocksImpl(in, inWidth, out, width, height, factor, sum, colSums);
+}
+
+void BinBlocks(const uint16_t *in, std::size_t inWidth, uint16_t *out,
+               std::size_t width, std::size_t height, unsigned factor,
+               bool sum, uint32_t *colSums) {
+    BinBlocksImpl(in, inWidth, out, width, height, factor, sum, colSums);
+}
+
+void PrimeAverage(const uint8_t *in, int32_t *average, std::size_t n) {
+    PrimeAverageImpl(in, average, n);
+}
+
+void PrimeAverage(const uint16_t *in, int32_t *average, std::size_t n) {
+    PrimeAverageImpl(in, average, n);
+}
+
+void RecursiveFilter(const uint8_t *in, int32_t *average, uint8_t *out,
+                     std::size_t n, int32_t gain) {
+    RecursiveFilterImpl(in, average, out, n, gain);
+}
+
+void RecursiveFilter(const uint16_t *in, int32_t *average, uint16_t *out,
+                     std::size_t n, int32_t gain) {
+    RecursiveFilterImpl(in, average, out, n, gain);
+}
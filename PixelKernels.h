@@ -0,0 +1,62 @@
+#pragma once
+
+// Per-pixel loops of the frame pipeline (see FramePipeline.h), for 8- and
+// 16-bit samples.
+//
+// Each kernel has an SSE2 implementation, used when compiling for x86 or x64
+// (where SSE2 is part of the baseline instruction set, so no run-time
+// dispatch is needed), and a scalar one giving identical results, used for
+// the remainder of each frame and on other targets, or everywhere when
+// OPENSCAN_MM_NO_SIMD is defined (-Dsimd=disabled).
+
+#include <cstddef>
+#include <cstdint>
+
+// Element-wise minimum to a and maximum to b: one step of the median
+// sorting networks
+void CompareExchange(uint8_t *a, uint8_t *b, std::size_t n);
+void CompareExchange(uint16_t *a, uint16_t *b, std::size_t n);
+
+// Reduces factor x factor blocks (factor 2, 4 or 8) of a frame inWidth
+// samples wide to their sum (saturating) or rounded mean; the remainder of
+// rows and columns is dropped. colSums holds width * factor values.
+void BinBlocks(const uint8_t *in, std::size_t inWidth, uint8_t *out,
+               std::size_t width, std::size_t height, unsigned factor,
+               bool sum, uint32_t *colSums);
+void BinBlocks(const uint16_t *in, std::size_t inWidth, uint16_t *out,
+               std::size_t width, std::size_t height, unsigned factor,
+               bool sum, uint32_t *colSums);
+
+// 16-bit samples to 8 bits: shifted right and clamped to 255, or with min
+// to max (max > min) mapped linearly to 0 to 255 and values outside clipped
+void ShiftTo8Bit(const uint16_t *in, uint8_t *out, std::size_t n,
+                 unsigned shift);
+void WindowTo8Bit(const uint16_t *in, uint8_t *out, std::size_t n,
+                  uint32_t min, uint32_t max);
+
+// Sliding-window sums for 32-bit output: sum = in; sum += in; or
+// sum += in - oldest, after which oldest is overwritten by in. Sums must
+// stay below 2^31.
+void WidenFrame(const uint8_t *in, uint32_t *sum, std::size_t n);
+void WidenFrame(const uint16_t *in, uint32_t *sum, std::size_t n);
+void AddFrame(const uint8_t *in, uint32_t *sum, std::size_t n);
+void AddFrame(const uint16_t *in, uint32_t *sum, std::size_t n);
+void ReplaceFrame(const uint8_t *in, uint8_t *oldest, uint32_t *sum,
+                  std::size_t n);
+void ReplaceFrame(const uint16_t *in, uint16_t *oldest, uint32_t *sum,
+                  std::size_t n);
+
+// Mean of count frames from their sum
+void MeanToFloat(const uint32_t *sum, float *out, std::size_t n,
+                 std::size_t count);
+
+// Recursive filter state: the running average of each pixel in fixed point
+void PrimeAverage(const uint8_t *in, int32_t *average, std::size_t n);
+void PrimeAverage(const uint16_t *in, int32_t *average, std::size_t n);
+
+// Moves the average towards the new frame by gain (in units of
+// 1 / FramePipeline::GAIN_ONE, at most GAIN_ONE) and writes it rounded
+void RecursiveFilter(const uint8_t *in, int32_t *average, uint8_t *out,
+                     std::size_t n, int32_t gain);
+void RecursiveFilter(const uint16_t *in, int32_t *average, uint16_t *out,
+                     std::size_t n, int32_t gain);
@@ -0,0 +1,43 @@
+#include "PreArmCache.h"
+
+void PreArmCache::SetCapacity(std::size_t capacity) {
+    capacity_ = capacity;
+    EvictTo(capacity);
+}
+
+bool PreArmCache::Contains(PreArmKind kind, const std::string &key) const {
+    for (const Entry &e : entries_) {
+        if (e.kind == kind && e.key == key)
+            return true;
+    }
+    return false;
+}
+
+OSc_Acquisition *PreArmCache::Take(PreArmKind kind, const std::string &key) {
+    OSc_Acquisition *found = 0;
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (it->kind != kind) {
+            ++it;
+            continue;
+        }
+        if (it->key == key && !found)
+            found = it->acq;
+        else
+            OSc_Acquisition_Destroy(it->acq);
+        it = entries_.erase(it);
+    }
+    return found;
+}
+
+void PreArmCache::Put(PreArmKind kind, const std::string &key,
+                      OSc_Acquisition *acq) {
+    entries_.push_front(Entry{kind, key, acq});
+    EvictTo(capacity_);
+}
+
+void PreArmCache::EvictTo(std::size_t size) {
+    while (entries_.size() > size) {
+        OSc_Acquisition_Destroy(entries_.back().acq);
+        entries_.pop_back();
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+// Armed acquisitions prepared ahead of need, keyed by the acquisition kind
+// and the template state they were armed with.
+//
+// Entries are kept in least-recently-used order and evicted (destroyed)
+// beyond the capacity. Most devices can only be armed for one acquisition at
+// a time, in which case the capacity must be 1 and EvictTo(0) must be called
+// before arming anything else. Not thread-safe.
+
+#include <OpenScanLib.h>
+
+#include <cstddef>
+#include <list>
+#include <string>
+
+enum PreArmKind {
+    PreArm_Snap, // One frame, snap callback
+    PreArm_Live, // Continuous sequence
+};
+
+class PreArmCache {
+    struct Entry {
+        PreArmKind kind;
+        std::string key;
+        OSc_Acquisition *acq;
+    };
+    std::list<Entry> entries_; // Most recently used first
+    std::size_t capacity_;
+
+  public:
+    explicit PreArmCache(std::size_t capacity) : capacity_(capacity) {}
+    ~PreArmCache() { Clear(); }
+
+    PreArmCache(const PreArmCache &) = delete;
+    PreArmCache &operator=(const PreArmCache &) = delete;
+
+    std::size_t Size() const { return entries_.size(); }
+    std::size_t Capacity() const { return capacity_; }
+    void SetCapacity(std::size_t capacity);
+
+    bool Contains(PreArmKind kind, const std::string &key) const;
+
+    // Removes and returns the matching acquisition, or null. Entries of the
+    // same kind armed with another template state are stale and destroyed.
+    OSc_Acquisition *Take(PreArmKind kind, const std::string &key);
+
+    // Caller must have made room (EvictTo(Capacity() - 1)) before arming
+    void Put(PreArmKind kind, const std::string &key, OSc_Acquisition *acq);
+
+    void EvictTo(std::size_t size);
+    void Clear() { EvictTo(0); }
+};
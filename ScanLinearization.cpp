@@ -0,0 +1,107 @@
+#include "ScanLinearization.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+// Distance travelled by time t (fraction of the line time), in units of the
+// distance travelled per line time at full speed, for a raised-cosine
+// velocity ramp over time r at each end
+double ScanPosition(double t, double r) {
+    if (r <= 0.0)
+        return t;
+    double total = 1.0 - r;
+    if (t > 1.0 - r)
+        return total - ScanPosition(1.0 - t, r);
+    if (t < r)
+        return 0.5 * t - 0.5 * r / PI * std::sin(PI * t / r);
+    return 0.5 * r + (t - r);
+}
+
+// Time at which the scanner reaches the given fraction of the line
+double ScanTime(double position, double r) {
+    double target = position * (1.0 - r);
+    double lo = 0.0, hi = 1.0;
+    for (int i = 0; i < 48; ++i) {
+        double mid = 0.5 * (lo + hi);
+        if (ScanPosition(mid, r) < target)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return 0.5 * (lo + hi);
+}
+
+// The table is the same for every row, so its entries stay in cache and
+// each row is a single pass with no arithmetic beyond the blend
+template <typename T>
+void Resample(const T *in, T *out, std::size_t width, std::size_t height,
+              const uint32_t *index, const uint16_t *weight) {
+    const uint32_t one = LinearizationTable::WEIGHT_ONE;
+    for (std::size_t y = 0; y < height; ++y) {
+        const T *src = in + y * width;
+        T *dst = out + y * width;
+        for (std::size_t x = 0; x < width; ++x) {
+            uint32_t w = weight[x];
+            uint32_t a = src[index[x]];
+            uint32_t b = src[index[x] + 1];
+            dst[x] = T((a * (one - w) + b * w + one / 2) >>
+                       LinearizationTable::WEIGHT_BITS);
+        }
+    }
+}
+
+} // namespace
+
+LinearizationTable::LinearizationTable(std::size_t width,
+                                       double turnaroundFraction)
+    : index_(width), weight_(width) {
+    double r = std::min(std::max(turnaroundFraction, 0.0), 0.5);
+    double last = double(width - 1);
+    for (std::size_t x = 0; x < width; ++x) {
+        // Pixel and sample centers are at (i + 0.5) / width
+        double t = ScanTime((x + 0.5) / width, r);
+        double s = std::min(std::max(t * width - 0.5, 0.0), last);
+        std::size_t i = std::min(std::size_t(s), width - 2);
+        index_[x] = uint32_t(i);
+        weight_[x] = uint16_t(std::lround((s - i) * WEIGHT_ONE));
+    }
+}
+
+bool LinearizationTable::Apply(const void *in, void *out, std::size_t height,
+                               std::size_t bytesPerPixel) const {
+    switch (bytesPerPixel) {
+    case 1:
+        Resample(static_cast<const uint8_t *>(in), static_cast<uint8_t *>(out),
+                 Width(), height, index_.data(), weight_.data());
+        return true;
+    case 2:
+        Resample(static_cast<const uint16_t *>(in),
+                 static_cast<uint16_t *>(out), Width(), height, index_.data(),
+                 weight_.data());
+        return true;
+    default:
+        return false;
+    }
+}
+
+std::shared_ptr<const LinearizationTable>
+LinearizationCache::Get(const std::string &key, std::size_t width,
+                        double turnaroundFraction) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if (it->key == key) {
+            entries_.splice(entries_.begin(), entries_, it);
+            return it->table;
+        }
+    }
+    auto table =
+        std::make_shared<const LinearizationTable>(width, turnaroundFraction);
+    entries_.push_front(Entry{key, table});
+    while (entries_.size() > capacity_)
+        entries_.pop_back();
+    return table;
+}
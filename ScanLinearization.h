@@ -0,0 +1,64 @@
+#pragma once
+
+// Resampling of scan lines onto uniformly spaced pixels.
+//
+// Samples are acquired at uniform time steps, but the scanner is still
+// accelerating near the ends of each line, so edge pixels cover less of the
+// field than central ones (the image looks stretched at the edges). The
+// scanner velocity is modeled as a raised-cosine ramp over the given
+// fraction of the line time at each end, and constant in between; a table
+// maps each output pixel to the two acquired samples around its position
+// and their interpolation weight.
+//
+// Tables are built once per configuration (outside the frame path) and are
+// immutable, so they can be shared between threads.
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class LinearizationTable {
+  public:
+    static const int WEIGHT_BITS = 8;
+    static const uint32_t WEIGHT_ONE = 1u << WEIGHT_BITS;
+
+    // Width at least 2; the fraction is clamped to [0, 0.5]
+    LinearizationTable(std::size_t width, double turnaroundFraction);
+
+    std::size_t Width() const { return index_.size(); }
+
+    // Resamples every row; false (nothing written) unless bytesPerPixel is
+    // 1 or 2. The buffers must not overlap.
+    bool Apply(const void *in, void *out, std::size_t height,
+               std::size_t bytesPerPixel) const;
+
+  private:
+    std::vector<uint32_t> index_;  // Left sample; index_ + 1 < width
+    std::vector<uint16_t> weight_; // Of the right sample, 0 to WEIGHT_ONE
+};
+
+// Tables for recently used configurations, least recently used first to be
+// dropped. Thread-safe.
+class LinearizationCache {
+    struct Entry {
+        std::string key;
+        std::shared_ptr<const LinearizationTable> table;
+    };
+    std::mutex mutex_;
+    std::list<Entry> entries_; // Most recently used first
+    std::size_t capacity_;
+
+  public:
+    explicit LinearizationCache(std::size_t capacity) : capacity_(capacity) {}
+
+    LinearizationCache(const LinearizationCache &) = delete;
+    LinearizationCache &operator=(const LinearizationCache &) = delete;
+
+    // The key must identify the width and fraction
+    std::shared_ptr<const LinearizationTable>
+    Get(const std::string &key, std::size_t width, double turnaroundFraction);
+};
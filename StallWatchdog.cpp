@@ -0,0 +1,75 @@
+#include "StallWatchdog.h"
+
+#include <algorithm>
+#include <utility>
+
+StallWatchdog::StallWatchdog(StallFunction onStall)
+    : onStall_(std::move(onStall)), lastProgressNs_(0), armed_(false),
+      timeout_(0), shutdownRequested_(false) {
+    thread_ = std::thread(&StallWatchdog::Run, this);
+}
+
+StallWatchdog::~StallWatchdog() { Shutdown(); }
+
+int64_t StallWatchdog::NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void StallWatchdog::Arm(std::chrono::milliseconds timeout) {
+    Progress();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        armed_ = true;
+        timeout_ = timeout;
+    }
+    cv_.notify_all();
+}
+
+void StallWatchdog::Disarm() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        armed_ = false;
+    }
+    cv_.notify_all();
+}
+
+void StallWatchdog::Shutdown() {
+    if (!thread_.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shutdownRequested_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+void StallWatchdog::Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!shutdownRequested_) {
+        if (!armed_) {
+            cv_.wait(lock, [this] { return armed_ || shutdownRequested_; });
+            continue;
+        }
+
+        // Check several times per timeout so stalls are caught promptly
+        std::chrono::milliseconds poll =
+            std::min(std::max(timeout_ / 4, std::chrono::milliseconds(10)),
+                     std::chrono::milliseconds(1000));
+        cv_.wait_for(lock, poll);
+        if (!armed_ || shutdownRequested_)
+            continue;
+
+        int64_t sinceProgressNs =
+            NowNs() - lastProgressNs_.load(std::memory_order_relaxed);
+        if (sinceProgressNs < std::chrono::nanoseconds(timeout_).count())
+            continue;
+
+        Progress(); // Restart the timer
+        lock.unlock();
+        onStall_(std::chrono::milliseconds(sinceProgressNs / 1000000));
+        lock.lock();
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+// Detects when a running acquisition stops making progress.
+//
+// While armed, the watchdog thread calls the stall function if Progress()
+// has not been called for longer than the timeout. After a stall is
+// reported, the timer restarts, so a persistent stall is reported once per
+// timeout. The stall function runs on the watchdog thread and must not call
+// Shutdown().
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+class StallWatchdog {
+  public:
+    typedef std::function<void(std::chrono::milliseconds)> StallFunction;
+
+  private:
+    StallFunction onStall_;
+
+    std::atomic<int64_t> lastProgressNs_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool armed_;
+    std::chrono::milliseconds timeout_;
+    bool shutdownRequested_;
+    std::thread thread_;
+
+    static int64_t NowNs();
+    void Run();
+
+  public:
+    explicit StallWatchdog(StallFunction onStall);
+    ~StallWatchdog();
+
+    StallWatchdog(const StallWatchdog &) = delete;
+    StallWatchdog &operator=(const StallWatchdog &) = delete;
+
+    // Start watching, counting the timeout from now
+    void Arm(std::chrono::milliseconds timeout);
+    // Does not wait for a stall function call in progress
+    void Disarm();
+    void Shutdown();
+
+    // Called from the frame callback; a single atomic store
+    void Progress() {
+        lastProgressNs_.store(NowNs(), std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,155 @@
+#include "TraceRing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+const std::size_t EVENTS_PER_THREAD = 16384; // Power of 2
+
+struct TraceEvent {
+    // seq is (index + 1) of the event stored in the slot, published after
+    // the other fields are written; readers use it to detect overwrites.
+    std::atomic<uint64_t> seq;
+    const char *name;
+    int64_t arg;
+    uint64_t timestampNs;
+    uint32_t threadId;
+    char phase;
+};
+
+struct ThreadRing {
+    std::atomic<uint64_t> writeIndex{0};
+    std::atomic<bool> inUse{false};
+    std::unique_ptr<TraceEvent[]> events{new TraceEvent[EVENTS_PER_THREAD]};
+
+    ThreadRing() {
+        for (std::size_t i = 0; i < EVENTS_PER_THREAD; ++i)
+            events[i].seq.store(0, std::memory_order_relaxed);
+    }
+};
+
+// Rings are never freed; when a thread exits its ring is handed to the next
+// new thread, so the number of rings is bounded by the number of threads
+// that record concurrently, and events from exited threads stay available
+// until overwritten.
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadRing>> registry;
+std::atomic<uint32_t> nextThreadId{1};
+
+ThreadRing *AcquireRing() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (auto &ring : registry) {
+        bool expected = false;
+        if (ring->inUse.compare_exchange_strong(expected, true))
+            return ring.get();
+    }
+    registry.emplace_back(new ThreadRing);
+    registry.back()->inUse = true;
+    return registry.back().get();
+}
+
+struct ThreadRingHandle {
+    ThreadRing *ring;
+    uint32_t threadId;
+
+    ThreadRingHandle() : ring(AcquireRing()), threadId(nextThreadId++) {}
+    ~ThreadRingHandle() { ring->inUse = false; }
+};
+
+uint64_t NowNs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+} // namespace
+
+void TraceRecord(const char *name, char phase, int64_t arg) {
+    static thread_local ThreadRingHandle handle;
+    ThreadRing *ring = handle.ring;
+
+    uint64_t index = ring->writeIndex.load(std::memory_order_relaxed);
+    TraceEvent &ev = ring->events[index & (EVENTS_PER_THREAD - 1)];
+    ev.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    ev.name = name;
+    ev.arg = arg;
+    ev.timestampNs = NowNs();
+    ev.threadId = handle.threadId;
+    ev.phase = phase;
+    ev.seq.store(index + 1, std::memory_order_release);
+    ring->writeIndex.store(index + 1, std::memory_order_release);
+}
+
+namespace {
+
+struct EventCopy {
+    const char *name;
+    int64_t arg;
+    uint64_t timestampNs;
+    uint32_t threadId;
+    char phase;
+};
+
+void SnapshotRing(ThreadRing &ring, std::vector<EventCopy> &out) {
+    uint64_t end = ring.writeIndex.load(std::memory_order_acquire);
+    uint64_t begin = end > EVENTS_PER_THREAD ? end - EVENTS_PER_THREAD : 0;
+    for (uint64_t i = begin; i < end; ++i) {
+        TraceEvent &ev = ring.events[i & (EVENTS_PER_THREAD - 1)];
+        if (ev.seq.load(std::memory_order_acquire) != i + 1)
+            continue;
+        EventCopy copy{ev.name, ev.arg, ev.timestampNs, ev.threadId,
+                       ev.phase};
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // Discard if the writer lapped us while we were copying
+        if (ev.seq.load(std::memory_order_relaxed) != i + 1)
+            continue;
+        out.push_back(copy);
+    }
+}
+
+} // namespace
+
+bool TraceDumpChromeJson(const std::string &path, std::string &errorMessage) {
+    std::vector<EventCopy> events;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (auto &ring : registry)
+            SnapshotRing(*ring, events);
+    }
+    std::sort(events.begin(), events.end(),
+              [](const EventCopy &a, const EventCopy &b) {
+                  return a.timestampNs < b.timestampNs;
+              });
+
+    FILE *fp = std::fopen(path.c_str(), "w");
+    if (!fp) {
+        errorMessage = "Cannot open trace file for writing: " + path;
+        return false;
+    }
+    std::fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        const EventCopy &ev = events[i];
+        // Chrome trace timestamps are in (fractional) microseconds
+        std::fprintf(fp,
+                     "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,"
+                     "\"pid\":1,\"tid\":%u%s,\"args\":{\"arg\":%lld}}",
+                     i ? "," : "", ev.name, ev.phase, ev.timestampNs / 1000.0,
+                     ev.threadId,
+                     ev.phase == TRACE_PHASE_INSTANT ? ",\"s\":\"t\"" : "",
+                     static_cast<long long>(ev.arg));
+    }
+    std::fprintf(fp, "\n]}\n");
+    if (std::fclose(fp) != 0) {
+        errorMessage = "Error writing trace file: " + path;
+        return false;
+    }
+    return true;
+}
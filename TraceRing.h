@@ -0,0 +1,44 @@
+#pragma once
+
+// In-process event tracing for the acquisition hot path.
+//
+// Each thread records into its own fixed-size ring, so recording takes no
+// locks and never allocates (after the thread's first event). The most
+// recent events of all threads can be written out as Chrome/Perfetto JSON
+// (load the file in chrome://tracing or ui.perfetto.dev).
+//
+// Trace points compile to nothing unless OPENSCAN_MM_TRACE is defined (meson
+// option 'trace'). Event names must be string literals.
+
+#include <cstdint>
+#include <string>
+
+// Phases follow the Chrome trace event format
+const char TRACE_PHASE_BEGIN = 'B';
+const char TRACE_PHASE_END = 'E';
+const char TRACE_PHASE_INSTANT = 'i';
+
+void TraceRecord(const char *name, char phase, int64_t arg);
+
+// Write all buffered events to path. On failure, returns false and sets
+// errorMessage.
+bool TraceDumpChromeJson(const std::string &path, std::string &errorMessage);
+
+#ifdef OPENSCAN_MM_TRACE
+#define OSCMM_TRACE_BEGIN(name, arg)                                           \
+    TraceRecord(name, TRACE_PHASE_BEGIN, static_cast<int64_t>(arg))
+#define OSCMM_TRACE_END(name, arg)                                             \
+    TraceRecord(name, TRACE_PHASE_END, static_cast<int64_t>(arg))
+#define OSCMM_TRACE_INSTANT(name, arg)                                         \
+    TraceRecord(name, TRACE_PHASE_INSTANT, static_cast<int64_t>(arg))
+#else
+#define OSCMM_TRACE_BEGIN(name, arg)                                           \
+    do {                                                                       \
+    } while (0)
+#define OSCMM_TRACE_END(name, arg)                                             \
+    do {                                                                       \
+    } while (0)
+#define OSCMM_TRACE_INSTANT(name, arg)                                         \
+    do {                                                                       \
+    } while (0)
+#endif
@@ -0,0 +1,61 @@
+#include "WorkerPool.h"
+
+#include <system_error>
+
+WorkerPool::WorkerPool(std::size_t threads)
+    : job_(nullptr), context_(nullptr), generation_(0), pending_(0),
+      shutdownRequested_(false) {
+    for (std::size_t index = 1; index < threads; ++index) {
+        try {
+            threads_.emplace_back(&WorkerPool::Run, this, index);
+        } catch (const std::system_error &) {
+            break; // Run with the threads started so far
+        }
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shutdownRequested_ = true;
+    }
+    startCv_.notify_all();
+    for (std::thread &thread : threads_)
+        thread.join();
+}
+
+void WorkerPool::RunOnAll(Job job, void *context) {
+    if (!threads_.empty()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = job;
+        context_ = context;
+        pending_ = threads_.size();
+        ++generation_;
+    }
+    startCv_.notify_all();
+    job(context, 0);
+    if (!threads_.empty()) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        doneCv_.wait(lock, [this] { return pending_ == 0; });
+    }
+}
+
+void WorkerPool::Run(std::size_t index) {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        startCv_.wait(lock, [&] {
+            return shutdownRequested_ || generation_ != seen;
+        });
+        if (shutdownRequested_)
+            return;
+        seen = generation_;
+        Job job = job_;
+        void *context = context_;
+        lock.unlock();
+        job(context, index);
+        lock.lock();
+        if (--pending_ == 0)
+            doneCv_.notify_one();
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+// A fixed set of threads that run one job at a time, each thread calling it
+// with its own index, for splitting per-frame work without starting threads
+// on the acquisition thread. Running a job does not allocate.
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool {
+  public:
+    typedef void (*Job)(void *context, std::size_t index);
+
+  private:
+    std::mutex mutex_;
+    std::condition_variable startCv_;
+    std::condition_variable doneCv_;
+    std::vector<std::thread> threads_;
+    Job job_;
+    void *context_;
+    uint64_t generation_; // Jobs started so far
+    std::size_t pending_; // Threads still running the current job
+    bool shutdownRequested_;
+
+    void Run(std::size_t index);
+
+    template <typename F> static void Invoke(void *f, std::size_t index) {
+        (*static_cast<F *>(f))(index);
+    }
+
+  public:
+    // Starts threads - 1 threads (the caller is the first); fewer, down to
+    // none, if threads cannot be started
+    explicit WorkerPool(std::size_t threads);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    std::size_t Threads() const { return threads_.size() + 1; }
+
+    // Calls job(context, i) for each i below Threads(), 0 on the calling
+    // thread, and returns when all calls have returned. Not reentrant.
+    void RunOnAll(Job job, void *context);
+
+    // Calls f(i) likewise; f is not copied
+    template <typename F> void RunOnAll(F &f) { RunOnAll(&Invoke<F>, &f); }
+};
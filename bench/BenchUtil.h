@@ -0,0 +1,141 @@
+#pragma once
+
+// Shared setup and reporting for the adapter benchmarks.
+//
+// Each benchmark prints a single flat JSON object of named metrics to
+// stdout, which is what compare_baseline.py consumes.
+
+#include "MockCore.h"
+#include "OpenScan.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+typedef std::chrono::steady_clock BenchClock;
+
+inline double NanosecondsSince(BenchClock::time_point start) {
+    return std::chrono::duration<double, std::nano>(BenchClock::now() - start)
+        .count();
+}
+
+class LatencySamples {
+    std::vector<double> samples_;
+    bool sorted_ = true;
+
+  public:
+    void Reserve(std::size_t n) { samples_.reserve(n); }
+    void Add(double ns) {
+        samples_.push_back(ns);
+        sorted_ = false;
+    }
+    std::size_t Count() const { return samples_.size(); }
+
+    double Percentile(double p) {
+        if (samples_.empty())
+            return 0.0;
+        if (!sorted_) {
+            std::sort(samples_.begin(), samples_.end());
+            sorted_ = true;
+        }
+        std::size_t idx =
+            static_cast<std::size_t>(p / 100.0 * (samples_.size() - 1) + 0.5);
+        return samples_[idx];
+    }
+
+    double Mean() const {
+        if (samples_.empty())
+            return 0.0;
+        double sum = 0.0;
+        for (double s : samples_)
+            sum += s;
+        return sum / samples_.size();
+    }
+};
+
+class MetricsReport {
+    std::string benchmark_;
+    std::vector<std::pair<std::string, double>> metrics_;
+
+  public:
+    explicit MetricsReport(std::string benchmark)
+        : benchmark_(std::move(benchmark)) {}
+
+    void Add(const std::string &name, double value) {
+        metrics_.emplace_back(name, value);
+    }
+
+    // Add mean, median and tail percentiles under a common prefix
+    void AddLatencies(const std::string &prefix, LatencySamples &samples) {
+        Add(prefix + ".mean_ns", samples.Mean());
+        Add(prefix + ".p50_ns", samples.Percentile(50.0));
+        Add(prefix + ".p99_ns", samples.Percentile(99.0));
+    }
+
+    void Print() const {
+        std::printf("{\n  \"benchmark\": \"%s\",\n  \"metrics\": {",
+                    benchmark_.c_str());
+        for (std::size_t i = 0; i < metrics_.size(); ++i) {
+            std::printf("%s\n    \"%s\": %.6g", i ? "," : "",
+                        metrics_[i].first.c_str(), metrics_[i].second);
+        }
+        std::printf("\n  }\n}\n");
+    }
+};
+
+// An OpenScan camera initialized on the synthetic device, with the mock core
+// and hub it needs.
+class BenchRig {
+    OpenScanHub hub_;
+    MockCore core_;
+    std::unique_ptr<OpenScan> camera_;
+
+    static bool SelectFirstDevice(OpenScan &camera, const char *propName) {
+        char value[MM::MaxStrLength + 1];
+        unsigned n = camera.GetNumberOfPropertyValues(propName);
+        for (unsigned i = 0; i < n; ++i) {
+            if (!camera.GetPropertyValueAt(propName, i, value))
+                continue;
+            if (std::string(value) == "Unselected")
+                continue;
+            return camera.SetProperty(propName, value) == DEVICE_OK;
+        }
+        return false;
+    }
+
+  public:
+    BenchRig() : core_(&hub_) {}
+    ~BenchRig() {
+        if (camera_)
+            camera_->Shutdown();
+    }
+
+    MockCore &Core() { return core_; }
+    OpenScan &Camera() { return *camera_; }
+
+    // Returns false (after printing a message) if the synthetic device
+    // module could not be found or the camera failed to initialize.
+    bool Initialize() {
+        hub_.SetCallback(&core_);
+        camera_.reset(new OpenScan());
+        camera_->SetCallback(&core_);
+        if (!SelectFirstDevice(*camera_, "Clock") ||
+            !SelectFirstDevice(*camera_, "Scanner") ||
+            !SelectFirstDevice(*camera_, "Detector-0")) {
+            std::fprintf(stderr, "Synthetic device module not found\n");
+            return false;
+        }
+        int err = camera_->Initialize();
+        if (err != DEVICE_OK) {
+            char msg[MM::MaxStrLength + 1];
+            camera_->GetErrorText(err, msg);
+            std::fprintf(stderr, "Initialize failed: %s\n", msg);
+            return false;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,193 @@
+#pragma once
+
+// Minimal stand-in for the Micro-Manager core, sufficient to initialize and
+// drive the OpenScan camera outside of MMCore.
+
+#include "OpenScan.h"
+
+#include "MMDevice.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+class MockCore : public MM::Core {
+    MM::Hub *hub_;
+    bool printLog_;
+
+    // Insert timestamps are only recorded up to the reserved capacity, so
+    // that recording never allocates on the acquisition thread.
+    std::vector<std::chrono::steady_clock::time_point> insertTimes_;
+
+    int RecordInsert() {
+        if (insertTimes_.size() < insertTimes_.capacity())
+            insertTimes_.push_back(std::chrono::steady_clock::now());
+        ++imagesInserted;
+        return DEVICE_OK;
+    }
+
+  public:
+    std::atomic<long> imagesInserted{0};
+    std::atomic<long> acquisitionsFinished{0};
+
+    explicit MockCore(MM::Hub *hub, bool printLog = false)
+        : hub_(hub), printLog_(printLog) {}
+
+    void ResetInsertTimes(std::size_t capacity) {
+        insertTimes_.clear();
+        insertTimes_.shrink_to_fit();
+        insertTimes_.reserve(capacity);
+        imagesInserted = 0;
+    }
+    const std::vector<std::chrono::steady_clock::time_point> &
+    InsertTimes() const {
+        return insertTimes_;
+    }
+
+    int LogMessage(const MM::Device *, const char *msg,
+                   bool debugOnly) const override {
+        if (printLog_ && !debugOnly)
+            std::fprintf(stderr, "%s\n", msg);
+        return DEVICE_OK;
+    }
+    MM::Device *GetDevice(const MM::Device *, const char *) override {
+        return 0;
+    }
+    int GetDeviceProperty(const char *, const char *, char *) override {
+        return DEVICE_ERR;
+    }
+    int SetDeviceProperty(const char *, const char *, const char *) override {
+        return DEVICE_ERR;
+    }
+    void GetLoadedDeviceOfType(const MM::Device *, MM::DeviceType,
+                               char *pDeviceName,
+                               const unsigned int) override {
+        pDeviceName[0] = '\0';
+    }
+
+    int SetSerialProperties(const char *, const char *, const char *,
+                            const char *, const char *, const char *,
+                            const char *) override {
+        return DEVICE_ERR;
+    }
+    int SetSerialCommand(const MM::Device *, const char *, const char *,
+                         const char *) override {
+        return DEVICE_ERR;
+    }
+    int GetSerialAnswer(const MM::Device *, const char *, unsigned long,
+                        char *, const char *) override {
+        return DEVICE_ERR;
+    }
+    int WriteToSerial(const MM::Device *, const char *, const unsigned char *,
+                      unsigned long) override {
+        return DEVICE_ERR;
+    }
+    int ReadFromSerial(const MM::Device *, const char *, unsigned char *,
+                       unsigned long, unsigned long &) override {
+        return DEVICE_ERR;
+    }
+    int PurgeSerial(const MM::Device *, const char *) override {
+        return DEVICE_ERR;
+    }
+    MM::PortType GetSerialPortType(const char *) const override {
+        return MM::InvalidPort;
+    }
+
+    int OnPropertiesChanged(const MM::Device *) override { return DEVICE_OK; }
+    int OnPropertyChanged(const MM::Device *, const char *,
+                          const char *) override {
+        return DEVICE_OK;
+    }
+    int OnStagePositionChanged(const MM::Device *, double) override {
+        return DEVICE_OK;
+    }
+    int OnXYStagePositionChanged(const MM::Device *, double,
+                                 double) override {
+        return DEVICE_OK;
+    }
+    int OnExposureChanged(const MM::Device *, double) override {
+        return DEVICE_OK;
+    }
+    int OnSLMExposureChanged(const MM::Device *, double) override {
+        return DEVICE_OK;
+    }
+    int OnMagnifierChanged(const MM::Device *) override { return DEVICE_OK; }
+
+    unsigned long GetClockTicksUs(const MM::Device *) override {
+        return static_cast<unsigned long>(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch())
+                .count());
+    }
+    MM::MMTime GetCurrentMMTime() override {
+        return MM::MMTime(static_cast<double>(GetClockTicksUs(0)));
+    }
+
+    int AcqFinished(const MM::Device *, int) override {
+        ++acquisitionsFinished;
+        return DEVICE_OK;
+    }
+    int PrepareForAcq(const MM::Device *) override { return DEVICE_OK; }
+    int InsertImage(const MM::Device *, const ImgBuffer &) override {
+        return RecordInsert();
+    }
+    int InsertImage(const MM::Device *, const unsigned char *, unsigned,
+                    unsigned, unsigned, unsigned, const char *,
+                    const bool) override {
+        return RecordInsert();
+    }
+    int InsertImage(const MM::Device *, const unsigned char *, unsigned,
+                    unsigned, unsigned, const Metadata *,
+                    const bool) override {
+        return RecordInsert();
+    }
+    int InsertImage(const MM::Device *, const unsigned char *, unsigned,
+                    unsigned, unsigned, const char *, const bool) override {
+        return RecordInsert();
+    }
+    void ClearImageBuffer(const MM::Device *) override {}
+    bool InitializeImageBuffer(unsigned, unsigned, unsigned int, unsigned int,
+                               unsigned int) override {
+        return true;
+    }
+    int InsertMultiChannel(const MM::Device *, const unsigned char *,
+                           unsigned, unsigned, unsigned, unsigned,
+                           Metadata *) override {
+        return RecordInsert();
+    }
+
+    const char *GetImage() override { return 0; }
+    int GetImageDimensions(int &, int &, int &) override { return DEVICE_ERR; }
+    int GetFocusPosition(double &) override { return DEVICE_ERR; }
+    int SetFocusPosition(double) override { return DEVICE_ERR; }
+    int MoveFocus(double) override { return DEVICE_ERR; }
+    int SetXYPosition(double, double) override { return DEVICE_ERR; }
+    int GetXYPosition(double &, double &) override { return DEVICE_ERR; }
+    int MoveXYStage(double, double) override { return DEVICE_ERR; }
+    int SetExposure(double) override { return DEVICE_ERR; }
+    int GetExposure(double &) override { return DEVICE_ERR; }
+    int SetConfig(const char *, const char *) override { return DEVICE_ERR; }
+    int GetCurrentConfig(const char *, int, char *) override {
+        return DEVICE_ERR;
+    }
+    int GetChannelConfig(char *, const unsigned int) override {
+        return DEVICE_ERR;
+    }
+
+    MM::ImageProcessor *GetImageProcessor(const MM::Device *) override {
+        return 0;
+    }
+    MM::AutoFocus *GetAutoFocus(const MM::Device *) override { return 0; }
+    MM::Hub *GetParentHub(const MM::Device *) const override { return hub_; }
+    MM::State *GetStateDevice(const MM::Device *, const char *) override {
+        return 0;
+    }
+    MM::SignalIO *GetSignalIODevice(const MM::Device *,
+                                    const char *) override {
+        return 0;
+    }
+
+    void PostError(const int, const char *) override {}
+    void ClearPostedErrors() override {}
+};
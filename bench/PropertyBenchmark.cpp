@@ -0,0 +1,100 @@
+// Measures the cost of property get (BeforeGet) and set (AfterSet)
+// round-trips through the adapter into OpenScanLib, per setting value type.
+
+#include "BenchUtil.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+const int ITERATIONS = 2000;
+
+// Synthetic device settings are named "<Type>-<NN>", so the property names
+// are "Synthetic-<Type>-<NN>".
+const char *const VALUE_TYPES[] = {"String", "Bool", "Int32", "Float64",
+                                   "Enum"};
+
+std::string ValueForIteration(const std::string &type, int i) {
+    char buf[64];
+    if (type == "String")
+        std::snprintf(buf, sizeof(buf), "Value%d", i % 100);
+    else if (type == "Bool")
+        std::snprintf(buf, sizeof(buf), "%s", i % 2 ? "Yes" : "No");
+    else if (type == "Int32")
+        std::snprintf(buf, sizeof(buf), "%d", i % 1000);
+    else if (type == "Float64")
+        std::snprintf(buf, sizeof(buf), "%0.4f", (i % 1000) * 0.25);
+    else // Enum: exercise name -> value translation
+        std::snprintf(buf, sizeof(buf), "Option%d", i % 8);
+    return buf;
+}
+
+} // namespace
+
+int main() {
+    BenchRig rig;
+    if (!rig.Initialize())
+        return 1;
+    OpenScan &camera = rig.Camera();
+
+    std::map<std::string, std::vector<std::string>> propsByType;
+    char name[MM::MaxStrLength + 1];
+    for (unsigned i = 0; i < camera.GetNumberOfProperties(); ++i) {
+        if (!camera.GetPropertyName(i, name))
+            continue;
+        std::string propName(name);
+        for (const char *type : VALUE_TYPES) {
+            if (propName.find(std::string("-") + type + "-") !=
+                std::string::npos)
+                propsByType[type].push_back(propName);
+        }
+    }
+
+    MetricsReport report("property");
+    char value[MM::MaxStrLength + 1];
+    for (const char *type : VALUE_TYPES) {
+        const std::vector<std::string> &props = propsByType[type];
+        if (props.empty()) {
+            std::fprintf(stderr, "No %s properties found\n", type);
+            return 1;
+        }
+
+        LatencySamples gets, sets;
+        gets.Reserve(ITERATIONS * props.size());
+        sets.Reserve(ITERATIONS * props.size());
+        for (int i = 0; i < ITERATIONS; ++i) {
+            const std::string newValue = ValueForIteration(type, i);
+            for (const std::string &prop : props) {
+                BenchClock::time_point t = BenchClock::now();
+                int err = camera.SetProperty(prop.c_str(), newValue.c_str());
+                sets.Add(NanosecondsSince(t));
+                if (err != DEVICE_OK) {
+                    std::fprintf(stderr, "Set %s = %s failed (%d)\n",
+                                 prop.c_str(), newValue.c_str(), err);
+                    return 1;
+                }
+
+                t = BenchClock::now();
+                err = camera.GetProperty(prop.c_str(), value);
+                gets.Add(NanosecondsSince(t));
+                if (err != DEVICE_OK) {
+                    std::fprintf(stderr, "Get %s failed (%d)\n", prop.c_str(),
+                                 err);
+                    return 1;
+                }
+            }
+        }
+
+        std::string prefix = "property.";
+        prefix += type;
+        report.AddLatencies(prefix + ".get", gets);
+        report.AddLatencies(prefix + ".set", sets);
+    }
+
+    report.Print();
+    return 0;
+}
@@ -0,0 +1,58 @@
+// Measures sequence acquisition throughput and frame delivery intervals
+// through SendSequenceImage into the (mock) core, on the synthetic device.
+
+#include "BenchUtil.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+namespace {
+
+const long FRAMES = 2000;
+
+} // namespace
+
+int main() {
+    BenchRig rig;
+    if (!rig.Initialize())
+        return 1;
+    OpenScan &camera = rig.Camera();
+    MockCore &core = rig.Core();
+
+    const long expectedImages = FRAMES * camera.GetNumberOfChannels();
+    core.ResetInsertTimes(expectedImages);
+
+    BenchClock::time_point start = BenchClock::now();
+    int err = camera.StartSequenceAcquisition(FRAMES, 0.0, false);
+    if (err != DEVICE_OK) {
+        std::fprintf(stderr, "StartSequenceAcquisition failed (%d)\n", err);
+        return 1;
+    }
+    while (core.imagesInserted < expectedImages && camera.IsCapturing())
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    double totalNs = NanosecondsSince(start);
+    camera.StopSequenceAcquisition();
+
+    if (core.imagesInserted < expectedImages) {
+        std::fprintf(stderr, "Only %ld of %ld images were inserted\n",
+                     static_cast<long>(core.imagesInserted), expectedImages);
+        return 1;
+    }
+
+    LatencySamples intervals;
+    const auto &times = core.InsertTimes();
+    intervals.Reserve(times.size());
+    for (std::size_t i = 1; i < times.size(); ++i) {
+        intervals.Add(
+            std::chrono::duration<double, std::nano>(times[i] - times[i - 1])
+                .count());
+    }
+
+    MetricsReport report("sequence");
+    report.Add("sequence.throughput_images_per_s",
+               expectedImages / (totalNs * 1e-9));
+    report.AddLatencies("sequence.insert_interval", intervals);
+    report.Print();
+    return 0;
+}
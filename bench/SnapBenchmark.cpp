@@ -0,0 +1,47 @@
+// Measures end-to-end SnapImage latency (create, arm, start, wait and copy of
+// all channels) on the synthetic device.
+
+#include "BenchUtil.h"
+
+#include <cstdio>
+
+namespace {
+
+const int WARMUP_SNAPS = 5;
+const int SNAPS = 200;
+
+} // namespace
+
+int main() {
+    BenchRig rig;
+    if (!rig.Initialize())
+        return 1;
+    OpenScan &camera = rig.Camera();
+
+    for (int i = 0; i < WARMUP_SNAPS; ++i) {
+        if (camera.SnapImage() != DEVICE_OK) {
+            std::fprintf(stderr, "SnapImage failed\n");
+            return 1;
+        }
+    }
+
+    LatencySamples snaps;
+    snaps.Reserve(SNAPS);
+    BenchClock::time_point start = BenchClock::now();
+    for (int i = 0; i < SNAPS; ++i) {
+        BenchClock::time_point t = BenchClock::now();
+        int err = camera.SnapImage();
+        snaps.Add(NanosecondsSince(t));
+        if (err != DEVICE_OK || !camera.GetImageBuffer(0)) {
+            std::fprintf(stderr, "SnapImage failed (%d)\n", err);
+            return 1;
+        }
+    }
+    double totalNs = NanosecondsSince(start);
+
+    MetricsReport report("snap");
+    report.AddLatencies("snap.latency", snaps);
+    report.Add("snap.throughput_per_s", SNAPS / (totalNs * 1e-9));
+    report.Print();
+    return 0;
+}
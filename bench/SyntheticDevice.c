@@ -0,0 +1,448 @@
+// Synthetic OpenScan device module used by the adapter benchmarks.
+//
+// Provides a single device that acts as clock, scanner and detector, carries
+// a realistic number of settings of every value type, and generates frames
+// as fast as the frame callback accepts them. No hardware is involved, so
+// the measured cost is that of OpenScanLib and the adapter.
+
+#include <OpenScanDeviceLib.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#define SETTINGS_PER_TYPE 8
+#define ENUM_NUM_VALUES 8
+#define NUM_CHANNELS 2
+
+struct SyntheticData {
+    char stringValues[SETTINGS_PER_TYPE][OScDev_MAX_STR_SIZE];
+    bool boolValues[SETTINGS_PER_TYPE];
+    int32_t int32Values[SETTINGS_PER_TYPE];
+    double float64Values[SETTINGS_PER_TYPE];
+    uint32_t enumValues[SETTINGS_PER_TYPE];
+
+    OScDev_Acquisition *acquisition;
+    uint32_t width;
+    uint32_t height;
+    volatile bool stopRequested;
+    volatile bool running;
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+};
+
+static struct SyntheticData *GetData(OScDev_Device *device) {
+    return (struct SyntheticData *)OScDev_Device_GetImplData(device);
+}
+
+// The impl data of each setting points directly at its value in
+// SyntheticData.
+
+static OScDev_Error GetString(OScDev_Setting *setting, char *value) {
+    char *p = (char *)OScDev_Setting_GetImplData(setting);
+    strncpy(value, p, OScDev_MAX_STR_SIZE);
+    return OScDev_OK;
+}
+
+static OScDev_Error SetString(OScDev_Setting *setting, const char *value) {
+    char *p = (char *)OScDev_Setting_GetImplData(setting);
+    strncpy(p, value, OScDev_MAX_STR_SIZE - 1);
+    return OScDev_OK;
+}
+
+static OScDev_Error GetBool(OScDev_Setting *setting, bool *value) {
+    *value = *(bool *)OScDev_Setting_GetImplData(setting);
+    return OScDev_OK;
+}
+
+static OScDev_Error SetBool(OScDev_Setting *setting, bool value) {
+    *(bool *)OScDev_Setting_GetImplData(setting) = value;
+    return OScDev_OK;
+}
+
+static OScDev_Error GetInt32(OScDev_Setting *setting, int32_t *value) {
+    *value = *(int32_t *)OScDev_Setting_GetImplData(setting);
+    return OScDev_OK;
+}
+
+static OScDev_Error SetInt32(OScDev_Setting *setting, int32_t value) {
+    *(int32_t *)OScDev_Setting_GetImplData(setting) = value;
+    return OScDev_OK;
+}
+
+static OScDev_Error GetNumericConstraintTypeImpl_Range(
+    OScDev_Setting *setting, OScDev_ValueConstraint *constraintType) {
+    *constraintType = OScDev_ValueConstraint_Continuous;
+    return OScDev_OK;
+}
+
+static OScDev_Error GetInt32Range(OScDev_Setting *setting, int32_t *min,
+                                  int32_t *max) {
+    *min = 0;
+    *max = 65535;
+    return OScDev_OK;
+}
+
+static OScDev_Error GetFloat64(OScDev_Setting *setting, double *value) {
+    *value = *(double *)OScDev_Setting_GetImplData(setting);
+    return OScDev_OK;
+}
+
+static OScDev_Error SetFloat64(OScDev_Setting *setting, double value) {
+    *(double *)OScDev_Setting_GetImplData(setting) = value;
+    return OScDev_OK;
+}
+
+static OScDev_Error GetFloat64Range(OScDev_Setting *setting, double *min,
+                                    double *max) {
+    *min = 0.0;
+    *max = 1000.0;
+    return OScDev_OK;
+}
+
+static OScDev_Error GetEnum(OScDev_Setting *setting, uint32_t *value) {
+    *value = *(uint32_t *)OScDev_Setting_GetImplData(setting);
+    return OScDev_OK;
+}
+
+static OScDev_Error SetEnum(OScDev_Setting *setting, uint32_t value) {
+    *(uint32_t *)OScDev_Setting_GetImplData(setting) = value;
+    return OScDev_OK;
+}
+
+static OScDev_Error GetEnumNumValues(OScDev_Setting *setting,
+                                     uint32_t *count) {
+    *count = ENUM_NUM_VALUES;
+    return OScDev_OK;
+}
+
+static OScDev_Error GetEnumNameForValue(OScDev_Setting *setting,
+                                        uint32_t value, char *name) {
+    snprintf(name, OScDev_MAX_STR_SIZE, "Option%u", value);
+    return OScDev_OK;
+}
+
+static OScDev_Error GetEnumValueForName(OScDev_Setting *setting,
+                                        uint32_t *value, const char *name) {
+    // Deliberately a linear scan by name, like typical device modules
+    for (uint32_t i = 0; i < ENUM_NUM_VALUES; ++i) {
+        char candidate[OScDev_MAX_STR_SIZE];
+        GetEnumNameForValue(setting, i, candidate);
+        if (strcmp(candidate, name) == 0) {
+            *value = i;
+            return OScDev_OK;
+        }
+    }
+    return OScDev_Error_Unknown;
+}
+
+static OScDev_SettingImpl SettingImpl_String = {
+    .GetString = GetString,
+    .SetString = SetString,
+};
+
+static OScDev_SettingImpl SettingImpl_Bool = {
+    .GetBool = GetBool,
+    .SetBool = SetBool,
+};
+
+static OScDev_SettingImpl SettingImpl_Int32 = {
+    .GetInt32 = GetInt32,
+    .SetInt32 = SetInt32,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetInt32Range = GetInt32Range,
+};
+
+static OScDev_SettingImpl SettingImpl_Float64 = {
+    .GetFloat64 = GetFloat64,
+    .SetFloat64 = SetFloat64,
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetFloat64Range = GetFloat64Range,
+};
+
+static OScDev_SettingImpl SettingImpl_Enum = {
+    .GetEnum = GetEnum,
+    .SetEnum = SetEnum,
+    .GetEnumNumValues = GetEnumNumValues,
+    .GetEnumNameForValue = GetEnumNameForValue,
+    .GetEnumValueForName = GetEnumValueForName,
+};
+
+static OScDev_Error SyntheticGetModelName(const char **name) {
+    *name = "Synthetic";
+    return OScDev_OK;
+}
+
+static OScDev_Error SyntheticEnumerateInstances(OScDev_PtrArray **devices,
+                                                OScDev_DeviceImpl *impl) {
+    struct SyntheticData *data = calloc(1, sizeof(struct SyntheticData));
+    if (!data)
+        return OScDev_Error_Unknown;
+    for (int i = 0; i < SETTINGS_PER_TYPE; ++i) {
+        snprintf(data->stringValues[i], OScDev_MAX_STR_SIZE, "Value%d", i);
+        data->int32Values[i] = i;
+        data->float64Values[i] = i * 0.5;
+    }
+
+    OScDev_Device *device;
+    OScDev_Error err = OScDev_Device_Create(&device, impl, data);
+    if (err) {
+        free(data);
+        return err;
+    }
+    *devices = OScDev_PtrArray_Create();
+    OScDev_PtrArray_Append(*devices, device);
+    return OScDev_OK;
+}
+
+static OScDev_Error SyntheticReleaseInstance(OScDev_Device *device) {
+    free(GetData(device));
+    return OScDev_OK;
+}
+
+static OScDev_Error SyntheticGetName(OScDev_Device *device, char *name) {
+    strncpy(name, "Synthetic", OScDev_MAX_STR_SIZE);
+    return OScDev_OK;
+}
+
+static OScDev_Error SyntheticOpen(OScDev_Device *device) { return OScDev_OK; }
+
+static OScDev_Error SyntheticClose(OScDev_Device *device) {
+    return OScDev_OK;
+}
+
+static OScDev_Error SyntheticHasFunction(OScDev_Device *device, bool *has) {
+    *has = true;
+    return OScDev_OK;
+}
+
+static OScDev_Error AppendSettings(OScDev_PtrArray *settings,
+                                   const char *prefix, OScDev_ValueType type,
+                                   OScDev_SettingImpl *impl, char *base,
+                                   size_t stride) {
+    for (int i = 0; i < SETTINGS_PER_TYPE; ++i) {
+        char name[OScDev_MAX_STR_SIZE];
+        snprintf(name, sizeof(name), "%s-%02d", prefix, i);
+        OScDev_Setting *setting;
+        OScDev_Error err = OScDev_Setting_Create(&setting, name, type, impl,
+                                                 base + i * stride);
+        if (err)
+            return err;
+        OScDev_PtrArray_Append(settings, setting);
+    }
+    return OScDev_OK;
+}
+
+static OScDev_Error SyntheticMakeSettings(OScDev_Device *device,
+                                          OScDev_PtrArray **settings) {
+    struct SyntheticData *data = GetData(device);
+    OScDev_Error err;
+    *settings = OScDev_PtrArray_Create();
+    if ((err = AppendSettings(*settings, "String", OScDev_ValueType_String,
+                              &SettingImpl_String,
+                              (char *)data->stringValues,
+                              sizeof(data->stringValues[0]))) != OScDev_OK)
+        return err;
+    if ((err = AppendSettings(*settings, "Bool", OScDev_ValueType_Bool,
+                              &SettingImpl_Bool, (char *)data->boolValues,
+                              sizeof(data->boolValues[0]))) != OScDev_OK)
+        return err;
+    if ((err = AppendSettings(*settings, "Int32", OScDev_ValueType_Int32,
+                              &SettingImpl_Int32, (char *)data->int32Values,
+                              sizeof(data->int32Values[0]))) != OScDev_OK)
+        return err;
+    if ((err = AppendSettings(*settings, "Float64", OScDev_ValueType_Float64,
+                              &SettingImpl_Float64,
+                              (char *)data->float64Values,
+                              sizeof(data->float64Values[0]))) != OScDev_OK)
+        return err;
+    if ((err = AppendSettings(*settings, "Enum", OScDev_ValueType_Enum,
+                              &SettingImpl_Enum, (char *)data->enumValues,
+                              sizeof(data->enumValues[0]))) != OScDev_OK)
+        return err;
+    return OScDev_OK;
+}
+
+static OScDev_Error SyntheticGetPixelRates(OScDev_Device *device,
+                                           OScDev_NumRange **pixelRatesHz) {
+    *pixelRatesHz = OScDev_NumRange_CreateDiscrete();
+    OScDev_NumRange_AppendDiscrete(*pixelRatesHz, 1.25e6);
+    OScDev_NumRange_AppendDiscrete(*pixelRatesHz, 2.5e6);
+    OScDev_NumRange_AppendDiscrete(*pixelRatesHz, 5e6);
+    OScDev_NumRange_AppendDiscrete(*pixelRatesHz, 10e6);
+    return OScDev_OK;
+}
+
+static OScDev_Error SyntheticGetResolutions(OScDev_Device *device,
+                                            OScDev_NumRange **resolutions) {
+    *resolutions = OScDev_NumRange_CreateDiscrete();
+    OScDev_NumRange_AppendDiscrete(*resolutions, 256);
+    OScDev_NumRange_AppendDiscrete(*resolutions, 512);
+    OScDev_NumRange_AppendDiscrete(*resolutions, 1024);
+    OScDev_NumRange_AppendDiscrete(*resolutions, 2048);
+    return OScDev_OK;
+}
+
+static OScDev_Error SyntheticGetZoomFactors(OScDev_Device *device,
+                                            OScDev_NumRange **zooms) {
+    *zooms = OScDev_NumRange_CreateContinuous(0.2, 20.0);
+    return OScDev_OK;
+}
+
+static OScDev_Error SyntheticIsROIScanSupported(OScDev_Device *device,
+                                                bool *supported) {
+    *supported = true;
+    return OScDev_OK;
+}
+
+static OScDev_Error SyntheticGetNumberOfChannels(OScDev_Device *device,
+                                                 uint32_t *nChannels) {
+    *nChannels = NUM_CHANNELS;
+    return OScDev_OK;
+}
+
+static OScDev_Error SyntheticGetBytesPerSample(OScDev_Device *device,
+                                               uint32_t *bytesPerSample) {
+    *bytesPerSample = 2;
+    return OScDev_OK;
+}
+
+static OScDev_Error SyntheticArm(OScDev_Device *device,
+                                 OScDev_Acquisition *acq) {
+    struct SyntheticData *data = GetData(device);
+    if (data->running)
+        return OScDev_Error_Unknown;
+    uint32_t xOffset, yOffset;
+    OScDev_Acquisition_GetROI(acq, &xOffset, &yOffset, &data->width,
+                              &data->height);
+    data->acquisition = acq;
+    data->stopRequested = false;
+    return OScDev_OK;
+}
+
+static void GenerateFrames(struct SyntheticData *data) {
+    size_t nPixels = (size_t)data->width * data->height;
+    uint16_t *frames[NUM_CHANNELS];
+    for (int ch = 0; ch < NUM_CHANNELS; ++ch) {
+        frames[ch] = malloc(nPixels * sizeof(uint16_t));
+        for (size_t i = 0; i < nPixels; ++i)
+            frames[ch][i] = (uint16_t)((i * (ch + 1)) & 0x0fff);
+    }
+
+    uint32_t nFrames = OScDev_Acquisition_GetNumberOfFrames(data->acquisition);
+    for (uint32_t f = 0; f < nFrames && !data->stopRequested; ++f) {
+        for (int ch = 0; ch < NUM_CHANNELS; ++ch) {
+            frames[ch][0] = (uint16_t)f;
+            if (!OScDev_Acquisition_CallFrameCallback(data->acquisition, ch,
+                                                      frames[ch])) {
+                data->stopRequested = true;
+                break;
+            }
+        }
+    }
+
+    for (int ch = 0; ch < NUM_CHANNELS; ++ch)
+        free(frames[ch]);
+    data->running = false;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI AcquisitionThread(void *param) {
+    GenerateFrames(param);
+    return 0;
+}
+#else
+static void *AcquisitionThread(void *param) {
+    GenerateFrames(param);
+    return NULL;
+}
+#endif
+
+static OScDev_Error SyntheticStart(OScDev_Device *device) {
+    struct SyntheticData *data = GetData(device);
+    data->running = true;
+#ifdef _WIN32
+    data->thread = CreateThread(NULL, 0, AcquisitionThread, data, 0, NULL);
+    if (!data->thread) {
+        data->running = false;
+        return OScDev_Error_Unknown;
+    }
+#else
+    if (pthread_create(&data->thread, NULL, AcquisitionThread, data) != 0) {
+        data->running = false;
+        return OScDev_Error_Unknown;
+    }
+#endif
+    return OScDev_OK;
+}
+
+static OScDev_Error SyntheticWait(OScDev_Device *device) {
+    struct SyntheticData *data = GetData(device);
+    if (!data->acquisition)
+        return OScDev_OK;
+#ifdef _WIN32
+    WaitForSingleObject(data->thread, INFINITE);
+    CloseHandle(data->thread);
+#else
+    pthread_join(data->thread, NULL);
+#endif
+    data->acquisition = NULL;
+    return OScDev_OK;
+}
+
+static OScDev_Error SyntheticStop(OScDev_Device *device) {
+    GetData(device)->stopRequested = true;
+    return SyntheticWait(device);
+}
+
+static OScDev_Error SyntheticIsRunning(OScDev_Device *device,
+                                       bool *isRunning) {
+    *isRunning = GetData(device)->running;
+    return OScDev_OK;
+}
+
+static OScDev_DeviceImpl SyntheticDeviceImpl = {
+    .GetModelName = SyntheticGetModelName,
+    .EnumerateInstances = SyntheticEnumerateInstances,
+    .ReleaseInstance = SyntheticReleaseInstance,
+    .GetName = SyntheticGetName,
+    .Open = SyntheticOpen,
+    .Close = SyntheticClose,
+    .HasClock = SyntheticHasFunction,
+    .HasScanner = SyntheticHasFunction,
+    .HasDetector = SyntheticHasFunction,
+    .MakeSettings = SyntheticMakeSettings,
+    .GetPixelRates = SyntheticGetPixelRates,
+    .GetResolutions = SyntheticGetResolutions,
+    .GetZoomFactors = SyntheticGetZoomFactors,
+    .IsROIScanSupported = SyntheticIsROIScanSupported,
+    .GetNumberOfChannels = SyntheticGetNumberOfChannels,
+    .GetBytesPerSample = SyntheticGetBytesPerSample,
+    .Arm = SyntheticArm,
+    .Start = SyntheticStart,
+    .Stop = SyntheticStop,
+    .IsRunning = SyntheticIsRunning,
+    .Wait = SyntheticWait,
+};
+
+static OScDev_Error GetDeviceImpls(OScDev_PtrArray **impls) {
+    *impls = OScDev_PtrArray_CreateFromNullTerminated(
+        (OScDev_DeviceImpl *[]){&SyntheticDeviceImpl, NULL});
+    return OScDev_OK;
+}
+
+OScDev_MODULE_IMPL = {
+    .displayName = "OpenScan Synthetic Benchmark Device",
+    .GetDeviceImpls = GetDeviceImpls,
+};
@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Run the adapter benchmarks and compare their metrics to a stored baseline.
+
+Each benchmark executable prints a JSON object of the form
+{"benchmark": name, "metrics": {metric: value, ...}}. The baseline file lists,
+for each gated metric, the reference value, the relative tolerance and
+whether higher or lower is better. The script exits with status 1 if any
+metric regressed beyond its tolerance, or if any gated metric has no
+baseline value recorded (unless --allow-unrecorded is given).
+
+Baseline values are machine-specific; record them on the machine that runs
+the gate with --update (existing tolerances are preserved).
+"""
+
+import argparse
+import json
+import subprocess
+import sys
+
+DEFAULT_TOLERANCE = 0.2
+
+
+def run_benchmarks(executables):
+    metrics = {}
+    for exe in executables:
+        proc = subprocess.run([exe], stdout=subprocess.PIPE, check=True)
+        result = json.loads(proc.stdout)
+        metrics.update(result["metrics"])
+    return metrics
+
+
+def default_direction(metric):
+    return "higher" if "throughput" in metric else "lower"
+
+
+def update_baseline(baseline, metrics):
+    gated = baseline.setdefault("metrics", {})
+    for name, value in sorted(metrics.items()):
+        entry = gated.setdefault(
+            name,
+            {"tolerance": DEFAULT_TOLERANCE, "better": default_direction(name)},
+        )
+        entry["baseline"] = value
+
+
+def compare(baseline, metrics):
+    regressions = []
+    unrecorded = []
+    for name, entry in sorted(baseline.get("metrics", {}).items()):
+        reference = entry.get("baseline")
+        if name not in metrics:
+            regressions.append("{}: missing from benchmark output".format(name))
+            continue
+        current = metrics[name]
+        if reference is None:
+            print("{:50} {:>14.6g}  (no baseline recorded)".format(name, current))
+            unrecorded.append(name)
+            continue
+        tolerance = entry.get("tolerance", DEFAULT_TOLERANCE)
+        if entry.get("better", default_direction(name)) == "higher":
+            limit = reference * (1.0 - tolerance)
+            regressed = current < limit
+        else:
+            limit = reference * (1.0 + tolerance)
+            regressed = current > limit
+        change = (current - reference) / reference * 100.0 if reference else 0.0
+        print(
+            "{:50} {:>14.6g}  baseline {:>14.6g}  {:+7.1f}%{}".format(
+                name, current, reference, change, "  REGRESSED" if regressed else ""
+            )
+        )
+        if regressed:
+            regressions.append(
+                "{}: {:.6g} vs baseline {:.6g} (limit {:.6g})".format(
+                    name, current, reference, limit
+                )
+            )
+    return regressions, unrecorded
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--baseline", required=True, help="baseline JSON file")
+    parser.add_argument(
+        "--update",
+        action="store_true",
+        help="record the current results as the new baseline",
+    )
+    parser.add_argument(
+        "--allow-unrecorded",
+        action="store_true",
+        help="pass metrics that have no baseline value instead of failing",
+    )
+    parser.add_argument("benchmarks", nargs="+", help="benchmark executables")
+    args = parser.parse_args()
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+
+    metrics = run_benchmarks(args.benchmarks)
+
+    if args.update:
+        update_baseline(baseline, metrics)
+        with open(args.baseline, "w") as f:
+            json.dump(baseline, f, indent=4, sort_keys=True)
+            f.write("\n")
+        print("Baseline updated: {}".format(args.baseline))
+        return 0
+
+    regressions, unrecorded = compare(baseline, metrics)
+    failed = False
+    if regressions:
+        print("\nPerformance regressions:")
+        for r in regressions:
+            print("  " + r)
+        failed = True
+    if unrecorded and not args.allow_unrecorded:
+        print(
+            "\n{} metrics have no baseline value; record them with --update "
+            "or pass --allow-unrecorded".format(len(unrecorded))
+        )
+        failed = True
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())